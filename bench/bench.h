@@ -0,0 +1,20 @@
+#ifndef _AOC_BENCH_H
+#define _AOC_BENCH_H
+
+#include <algorithm>
+#include <chrono>
+
+// Best wall time of `runs` calls of f, in ms.
+template <typename F>
+static double best_of(int runs, F f) {
+    double best = 1e300;
+    for (int i = 0; i < runs; i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        f();
+        auto elapsed = std::chrono::steady_clock::now() - t0;
+        best = std::min(best, 1e-6 * std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+    return best;
+}
+
+#endif
@@ -0,0 +1,88 @@
+// Microbenchmark: reading lines of '0'/'1' into integers and counting the ones in each
+// column, byte by byte vs. parse::binary bit planes.
+//
+// Usage: bench_bit_planes [LINES] [WIDTH]
+
+#include <random>
+
+#include "aoc.h"
+#include "bench.h"
+
+using parse::input_t;
+
+int main(int argc, char **argv) {
+    const size_t lines = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    const int width = argc > 2 ? atoi(argv[2]) : 12;
+    assert(width <= 64);
+
+    std::mt19937_64 rng(42);
+    std::string text;
+    std::vector<uint64_t> expected(lines);
+    for (size_t i = 0; i < lines; i++) {
+        for (int b = 0; b < width; b++) {
+            bool bit = rng() & 1;
+            expected[i] = expected[i] << 1 | bit;
+            text += bit ? '1' : '0';
+        }
+        text += '\n';
+    }
+    text.append(64, '\0');  // INPUT_PADDING
+    const ssize_t len = text.size() - 64;
+
+    std::vector<uint64_t> numbers(lines);
+    std::array<size_t, 64> ones_scalar{}, ones_planes{};
+
+    // a switch over every character, reading and counting in one pass
+    double t_scalar = best_of(5, [&] {
+        ones_scalar.fill(0);
+        input_t in = {&text[0], len};
+        uint64_t current = 0;
+        size_t idx = 0, line = 0;
+        while (in.len) {
+            switch (*in.s) {
+                case '0':
+                    current <<= 1;
+                    idx++;
+                    break;
+                case '1':
+                    current = current << 1 | 1;
+                    ones_scalar[width - 1 - idx]++;
+                    idx++;
+                    break;
+                case '\n':
+                    numbers[line++] = current;
+                    current = 0;
+                    idx = 0;
+            }
+            in.s++, in.len--;
+        }
+    });
+    if (numbers != expected) abort();
+
+    std::fill(numbers.begin(), numbers.end(), 0);
+    double t_planes = best_of(5, [&] {
+        ones_planes.fill(0);
+        input_t in = {&text[0], len};
+        for (size_t line = 0; in.len > 0; line++) {
+            uint64_t current = parse::binary<uint64_t>(in, width);
+            in.s++, in.len--;  // '\n'
+            numbers[line] = current;
+            for (int b : bits(current)) ones_planes[b]++;
+        }
+    });
+    if (numbers != expected || ones_planes != ones_scalar) abort();
+
+    // LSB-first variant
+    input_t in = {&text[0], len};
+    for (size_t line = 0; line < lines; line++) {
+        uint64_t plane = parse::bitplane<uint64_t>(in, width, '1');
+        in.s++, in.len--;
+        if (reverse_bits(plane) >> (64 - width) != expected[line]) abort();
+    }
+
+    fmt::print("{} lines of {} bits\n", lines, width);
+    fmt::print("byte by byte: {:8.3f} ms\n", t_scalar);
+    fmt::print("bit planes:   {:8.3f} ms ({:.1f}x)\n", t_planes, t_scalar / t_planes);
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+// Microbenchmark: parse::numbers vs. parse::positive vs. parse::number (strtol).
+//
+// Usage: bench_parse_numbers [COUNT] [MAX]
+
+#include <random>
+
+#include "aoc.h"
+#include "bench.h"
+
+using parse::input_t;
+
+int main(int argc, char **argv) {
+    const size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    const long max = argc > 2 ? strtol(argv[2], nullptr, 10) : 1000000;
+
+    // mix of the separators used by the puzzles
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<long> dist(0, max);
+    const char *separators[] = {"\n", ",", " -> ", "  "};
+    std::string text;
+    std::vector<long> expected(count);
+    for (size_t i = 0; i < count; i++) {
+        expected[i] = dist(rng);
+        text += std::to_string(expected[i]);
+        text += separators[rng() % 4];
+    }
+    text.append(64, '\0');  // INPUT_PADDING
+
+    const ssize_t len = text.size() - 64;
+    std::vector<long> result(count);
+
+    double t_positive = best_of(5, [&] {
+        input_t in = {&text[0], len};
+        for (size_t i = 0; i < count; i++) result[i] = parse::positive<long>(in);
+    });
+    if (result != expected) abort();
+
+    double t_number = best_of(5, [&] {
+        input_t in = {&text[0], len};
+        for (size_t i = 0; i < count; i++) {
+            while (*in.s < '0' || *in.s > '9') in.s++, in.len--;
+            result[i] = parse::number(in);
+        }
+    });
+    if (result != expected) abort();
+
+    std::fill(result.begin(), result.end(), 0);
+    double t_numbers = best_of(5, [&] {
+        input_t in = {&text[0], len};
+        if (parse::numbers<long>(in, result) != count) abort();
+    });
+    if (result != expected) abort();
+
+    const double mb = len / 1e6;
+    fmt::print("{} numbers in [0, {}], {:.1f} MB\n", count, max, mb);
+    fmt::print("parse::positive: {:8.3f} ms {:8.1f} MB/s\n", t_positive, mb / t_positive * 1e3);
+    fmt::print("parse::number:   {:8.3f} ms {:8.1f} MB/s\n", t_number, mb / t_number * 1e3);
+    fmt::print("parse::numbers:  {:8.3f} ms {:8.1f} MB/s\n", t_numbers, mb / t_numbers * 1e3);
+
+    return 0;
+}
@@ -4,5 +4,6 @@
 #include "aoc.h"
 
 parse::output_t day01(parse::input_t in);
+parse::output_t day01_stream(parse::stream_t &in);
 
 #endif
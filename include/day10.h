@@ -4,5 +4,6 @@
 #include "aoc.h"
 
 parse::output_t day10(parse::input_t in);
+parse::output_t day10_stream(parse::stream_t &in);
 
 #endif
@@ -1,48 +1,392 @@
 #include <chrono>
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <ctime>
+#include <unistd.h>
 
 #include "aoc.h"
+#include "perf.h"
 
-int aoc_main(int argc, char **argv, const std::map<int, advent_t> &days) {
-    double total_time = 0;
+using clock_type = std::chrono::steady_clock;
+
+// Timings of the previous run, used to schedule the slowest days first.
+static constexpr const char *TIMINGS_FILE = ".aoc_timings";
+
+// Read hardware performance counters around each day (--perf).
+static bool use_counters = false;
+
+// Set on the workers of run_parallel, which already keep every core busy.
+static thread_local bool in_pool = false;
+
+unsigned available_threads() {
+    return in_pool ? 1 : std::max(1u, std::thread::hardware_concurrency());
+}
+
+struct task_t {
+    int day;
+    const advent_t *advent;
+    parse::input_t input;
+    double expected;  // ms, from the previous run
+    double elapsed;   // ms
+    std::optional<parse::output_t> output;
+    perf::sample_t counters;
+};
+
+static double elapsed_ms(clock_type::time_point t0) {
+    auto elapsed = clock_type::now() - t0;
+    return 1e-6 * std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
 
+static double cpu_ms() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return 1e3 * ts.tv_sec + 1e-6 * ts.tv_nsec;
+}
+
+static void load_task_input(task_t &task) {
+    char filename[32];
+    sprintf(filename, "input/day%02d.txt", task.day);
+    task.input = parse::load_input(filename);
+}
+
+static void run_task(task_t &task) {
+    if (use_counters) {
+        // opened on the thread that runs the day, so this also works with --jobs
+        perf::counters_t counters;
+        counters.start();
+        auto t0 = clock_type::now();
+        task.output = task.advent->fn(task.input);
+        task.elapsed = elapsed_ms(t0);
+        task.counters = counters.stop();
+        return;
+    }
+    auto t0 = clock_type::now();
+    task.output = task.advent->fn(task.input);
+    task.elapsed = elapsed_ms(t0);
+}
+
+// Formats a derived counter metric; unknown (negative) values are shown as '-'.
+static std::string metric(double value) {
+    return value < 0 ? fmt::format("{:>6}", "-") : fmt::format("{:6.2f}", value);
+}
+
+static std::map<int, double> load_timings() {
+    std::map<int, double> timings;
+    FILE *fp = fopen(TIMINGS_FILE, "r");
+    if (!fp) return timings;
+    int day;
+    double t;
+    while (fscanf(fp, "%d %lf", &day, &t) == 2) timings[day] = t;
+    fclose(fp);
+    return timings;
+}
+
+static void save_timings(const std::vector<task_t> &tasks) {
+    auto timings = load_timings();
+    for (auto &task : tasks) timings[task.day] = task.elapsed;
+
+    FILE *fp = fopen(TIMINGS_FILE, "w");
+    if (!fp) return;  // best effort
+    for (auto [day, t] : timings) fprintf(fp, "%d %.3f\n", day, t);
+    fclose(fp);
+}
+
+// Work-stealing scheduler: the tasks are dealt round-robin (longest expected first)
+// to one deque per worker. A worker pops from the front of its own deque and,
+// once that is empty, steals from the back of the others.
+static void run_parallel(std::vector<task_t> &tasks, size_t jobs) {
+    std::vector<task_t *> order;
+    order.reserve(tasks.size());
+    for (auto &task : tasks) order.push_back(&task);
+    std::stable_sort(order.begin(), order.end(), [](auto a, auto b) { return a->expected > b->expected; });
+
+    struct worker_queue {
+        std::mutex mtx;
+        std::deque<task_t *> tasks;
+    };
+    std::vector<worker_queue> queues(jobs);
+    for (size_t i = 0; i < order.size(); i++) queues[i % jobs].tasks.push_back(order[i]);
+
+    auto next_task = [&](size_t self) -> task_t * {
+        {
+            std::lock_guard lock(queues[self].mtx);
+            if (!queues[self].tasks.empty()) {
+                auto task = queues[self].tasks.front();
+                queues[self].tasks.pop_front();
+                return task;
+            }
+        }
+        for (size_t i = 1; i < jobs; i++) {
+            auto &victim = queues[(self + i) % jobs];
+            std::lock_guard lock(victim.mtx);
+            if (!victim.tasks.empty()) {
+                auto task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return task;
+            }
+        }
+        return nullptr;
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(jobs);
+    for (size_t i = 0; i < jobs; i++) {
+        workers.emplace_back([&, i] {
+            in_pool = true;
+            while (auto task = next_task(i)) run_task(*task);
+        });
+    }
+    for (auto &w : workers) w.join();
+}
+
+struct bench_opts_t {
+    size_t warmup = 2;
+    size_t repetitions = 0;  // 0: no benchmark
+    const char *json = nullptr;
+    const char *csv = nullptr;
+};
+
+struct stats_t {
+    double min, median, p95, mean, stddev;
+};
+
+static stats_t compute_stats(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    const size_t n = samples.size();
+    stats_t st;
+    st.min = samples.front();
+    st.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    st.p95 = samples[static_cast<size_t>(std::ceil(0.95 * n)) - 1];  // nearest rank
+    st.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / n;
+    double var = 0;
+    for (auto x : samples) var += (x - st.mean) * (x - st.mean);
+    st.stddev = n > 1 ? std::sqrt(var / (n - 1)) : 0;
+    return st;
+}
+
+// Runs every day `warmup` times, then `repetitions` measured times. Days keep no
+// global state, so every run must give the same answer.
+static void run_bench(std::vector<task_t> &tasks, const bench_opts_t &opts) {
+    std::vector<std::vector<double>> samples(tasks.size());
+    std::vector<stats_t> stats(tasks.size());
+
+    fmt::print("          Min          Median       P95          Stddev       Runs\n"
+               "=====================================================================\n");
+    for (size_t t = 0; t < tasks.size(); t++) {
+        auto &task = tasks[t];
+        load_task_input(task);
+
+        for (size_t i = 0; i < opts.warmup + opts.repetitions; i++) {
+            auto previous = task.output;
+            run_task(task);
+            if (previous && previous->answer != task.output->answer) {
+                fmt::print(stderr, "Day {:02d}: answer changed between runs\n", task.day);
+            }
+            if (i >= opts.warmup) samples[t].push_back(task.elapsed);
+        }
+        parse::free_input(task.input);
+
+        stats[t] = compute_stats(samples[t]);
+        task.elapsed = stats[t].median;
+        fmt::print("Day {:02d}: {:9.3f} ms {:9.3f} ms {:9.3f} ms {:9.3f} ms {:6}\n",
+                   task.day, stats[t].min, stats[t].median, stats[t].p95, stats[t].stddev, samples[t].size());
+    }
+
+    double total_min = 0, total_median = 0;
+    for (auto &st : stats) total_min += st.min, total_median += st.median;
+    fmt::print("=====================================================================\n"
+               "Total:  {:9.3f} ms {:9.3f} ms\n",
+               total_min, total_median);
+
+    if (opts.json) {
+        FILE *fp = fopen(opts.json, "w");
+        if (!fp) {
+            perror(opts.json);
+            exit(EXIT_FAILURE);
+        }
+        fmt::print(fp, "{{\n  \"warmup\": {},\n  \"repetitions\": {},\n  \"days\": [", opts.warmup, opts.repetitions);
+        for (size_t t = 0; t < tasks.size(); t++) {
+            auto &st = stats[t];
+            fmt::print(fp, "{}\n    {{\"day\": {}, \"min\": {:.6f}, \"median\": {:.6f}, \"p95\": {:.6f}, \"mean\": {:.6f}, \"stddev\": {:.6f}, \"samples\": [{:.6f}]}}",
+                       t ? "," : "", tasks[t].day, st.min, st.median, st.p95, st.mean, st.stddev, fmt::join(samples[t], ", "));
+        }
+        fmt::print(fp, "\n  ]\n}}\n");
+        fclose(fp);
+    }
+
+    if (opts.csv) {
+        FILE *fp = fopen(opts.csv, "w");
+        if (!fp) {
+            perror(opts.csv);
+            exit(EXIT_FAILURE);
+        }
+        fmt::print(fp, "day,min_ms,median_ms,p95_ms,mean_ms,stddev_ms,runs\n");
+        for (size_t t = 0; t < tasks.size(); t++) {
+            auto &st = stats[t];
+            fmt::print(fp, "{},{:.6f},{:.6f},{:.6f},{:.6f},{:.6f},{}\n",
+                       tasks[t].day, st.min, st.median, st.p95, st.mean, st.stddev, samples[t].size());
+        }
+        fclose(fp);
+    }
+}
+
+static void usage(const char *prog) {
+    fmt::print(stderr,
+               "Usage: {} [--jobs N] [--perf] [DAY]\n"
+               "       {} --bench N [--warmup N] [--json FILE] [--csv FILE] [DAY]\n"
+               "       {} --stdin DAY\n",
+               prog, prog, prog);
+    exit(EXIT_FAILURE);
+}
+
+int aoc_main(int argc, char **argv, const std::map<int, advent_t> &days) {
     std::unordered_set<int> indices;
+    size_t jobs = 0;  // 0: sequential
+    bench_opts_t bench;
+    bool from_stdin = false;
 
-    if (argc > 1) {
-        char *ptr;
-        long x = strtol(argv[1], &ptr, 10);
-        indices.insert(static_cast<int>(x));
-    } else {
+    for (int i = 1; i < argc; i++) {
+        auto is_option = [&](const char *name) {
+            if (strcmp(argv[i], name) != 0) return false;
+            if (++i == argc) usage(argv[0]);
+            return true;
+        };
+        if (strcmp(argv[i], "--perf") == 0) {
+            use_counters = true;
+        } else if (strcmp(argv[i], "--stdin") == 0) {
+            from_stdin = true;
+        } else if (is_option("--jobs") || is_option("-j")) {
+            long n = strtol(argv[i], nullptr, 10);
+            jobs = n > 0 ? n : std::max(1u, std::thread::hardware_concurrency());
+        } else if (is_option("--bench")) {
+            bench.repetitions = std::max(1l, strtol(argv[i], nullptr, 10));
+        } else if (is_option("--warmup")) {
+            bench.warmup = std::max(0l, strtol(argv[i], nullptr, 10));
+        } else if (is_option("--json")) {
+            bench.json = argv[i];
+        } else if (is_option("--csv")) {
+            bench.csv = argv[i];
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+        } else {
+            char *ptr;
+            long x = strtol(argv[i], &ptr, 10);
+            indices.insert(static_cast<int>(x));
+        }
+    }
+    // benchmarks are always run sequentially to keep the measurements quiet
+    if (jobs && bench.repetitions) usage(argv[0]);
+    if (from_stdin && (jobs || bench.repetitions || indices.size() != 1)) usage(argv[0]);
+    if (indices.empty()) {
         indices.reserve(25);
         for (size_t day = 1; day <= 25; day++) {
             indices.insert(day);
         }
     }
 
-    fmt::print("          Time         Part 1           Part 2\n"
-               "========================================================\n");
-    for (const auto element : days) {
+    auto timings = load_timings();
+    std::vector<task_t> tasks;
+    for (const auto &element : days) {
         if (indices.find(element.first) == indices.end()) continue;
         auto &A = element.second;
         if (!A.fn) continue;
 
-        char filename[32];
-        sprintf(filename, "input/day%02d.txt", element.first);
+        auto it = timings.find(element.first);
+        tasks.push_back(task_t{
+            .day = element.first,
+            .advent = &A,
+            .input = {},
+            .expected = it != timings.end() ? it->second : 0,
+            .elapsed = 0,
+            .output = std::nullopt,
+            .counters = {},
+        });
+    }
+
+    if (from_stdin) {
+        if (tasks.empty() || !tasks[0].advent->stream) {
+            fmt::print(stderr, "Day {:02d} cannot read from a stream\n", *indices.begin());
+            return EXIT_FAILURE;
+        }
+        auto &task = tasks[0];
+        auto st = parse::open_stream(STDIN_FILENO);
+        auto t0 = clock_type::now();
+        task.output = task.advent->stream(st);
+        task.elapsed = elapsed_ms(t0);
+        parse::close_stream(st);
+        fmt::print("Day {:02d}: {:9.3f} ms     {:<16} {:<16}\n",
+                   task.day, task.elapsed, task.output->answer[0], task.output->answer[1]);
+        return 0;
+    }
 
-        auto input = parse::load_input(filename);
-        auto t0 = std::chrono::steady_clock::now();
-        auto output = A.fn(input);
-        auto elapsed = std::chrono::steady_clock::now() - t0;
-        parse::free_input(input);
+    if (bench.repetitions) {
+        run_bench(tasks, bench);
+        save_timings(tasks);
+        return 0;
+    }
 
-        double t = 1e-6 * std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
-        total_time += t;
+    const char *separator = "========================================================";
+    if (use_counters) {
+        if (!perf::counters_t().available()) {
+            fmt::print(stderr, "warning: hardware performance counters are not available (see perf_event_paranoid)\n");
+        }
+        separator = "=========================================================================================";
+        fmt::print("          Time            IPC  L1D/ki LLC/ki  Br/ki    Part 1           Part 2\n"
+                   "{}\n",
+                   separator);
+    } else {
+        fmt::print("          Time         Part 1           Part 2\n"
+                   "{}\n",
+                   separator);
+    }
 
-        fmt::print("Day {:02d}: {:9.3f} ms     {:<16} {:<16}\n",
-                   element.first, t, output.answer[0], output.answer[1]);
+    double wall_time = 0, cpu_time = 0;
+    if (jobs) {
+        // load everything up front so that the workers only compute
+        for (auto &task : tasks) load_task_input(task);
+        jobs = std::max<size_t>(1, std::min(jobs, tasks.size()));
+        const double cpu0 = cpu_ms();
+        const auto t0 = clock_type::now();
+        run_parallel(tasks, jobs);
+        wall_time = elapsed_ms(t0);
+        cpu_time = cpu_ms() - cpu0;
     }
-    fmt::print("========================================================\n"
+
+    double total_time = 0;
+    for (auto &task : tasks) {
+        if (!jobs) {
+            load_task_input(task);
+            run_task(task);
+        }
+        parse::free_input(task.input);
+        total_time += task.elapsed;
+
+        if (use_counters) {
+            auto &c = task.counters;
+            fmt::print("Day {:02d}: {:9.3f} ms     {} {} {} {}    {:<16} {:<16}\n",
+                       task.day, task.elapsed,
+                       metric(c.ipc()), metric(c.mpki(perf::L1D_MISSES)), metric(c.mpki(perf::LLC_MISSES)), metric(c.mpki(perf::BRANCH_MISSES)),
+                       task.output->answer[0], task.output->answer[1]);
+        } else {
+            fmt::print("Day {:02d}: {:9.3f} ms     {:<16} {:<16}\n",
+                       task.day, task.elapsed, task.output->answer[0], task.output->answer[1]);
+        }
+    }
+
+    fmt::print("{}\n"
                "Total:  {:9.3f} ms\n",
-               total_time);
+               separator, total_time);
+    if (jobs) {
+        fmt::print("Wall:   {:9.3f} ms     ({} jobs)\n"
+                   "CPU:    {:9.3f} ms\n",
+                   wall_time, jobs, cpu_time);
+    }
+
+    // days running side by side slow each other down, keep the quiet measurements
+    if (!jobs) save_timings(tasks);
 
     return 0;
 }
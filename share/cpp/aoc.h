@@ -32,9 +32,12 @@
 #include "log.h"
 #include "hash.h"
 #include "pair.h"
+#include "pool.h"
 
 struct advent_t {
     parse::output_t (*fn)(parse::input_t);
+    // Single-pass variant reading from a stream with bounded memory (optional).
+    parse::output_t (*stream)(parse::stream_t &) = nullptr;
 };
 
 int aoc_main(int argc, char **argv, const std::map<int, advent_t> &days);
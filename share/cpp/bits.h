@@ -1,6 +1,7 @@
 #ifndef _AOC_BITS
 #define _AOC_BITS
 
+#include <bit>
 #include <cstddef>
 
 // Iterate over bits using range-for syntax:
@@ -14,7 +15,7 @@ struct bits {
         return *this;
     }
     bool operator!=(const bits& o) const { return mask != o.mask; }
-    inline int operator*() const { return _mm_tzcnt_64(mask); }
+    inline int operator*() const { return std::countr_zero(mask); }
     bits begin() const { return mask; }
     bits end() const { return 0; }
 };
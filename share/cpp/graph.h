@@ -1,105 +1,156 @@
-#include <cstdint>
-#include <sstream>
-#include <iostream>
+#ifndef _AOC_GRAPH
+#define _AOC_GRAPH
+
+#include <algorithm>
 #include <cassert>
+#include <compare>
+#include <cstdint>
 #include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
-namespace graph {
-
-/*
-Based on:
-
-Copyright 2003 by Steven S. Skiena; all rights reserved.
+#include "pool.h"
 
-Permission is granted for use in non-commerical applications
-provided this copyright notice remains intact and unchanged.
-
-This program appears in my book:
-
-"Programming Challenges: The Programming Contest Training Manual"
-by Steven Skiena and Miguel Revilla, Springer-Verlag, New York 2003.
+namespace graph {
 
-See our website www.programming-challenges.com for additional information.
+// Weight type of unweighted graphs, takes no space.
+struct none_t {
+    bool operator==(const none_t &) const = default;
+    auto operator<=>(const none_t &) const = default;
+};
 
-This book can be ordered from Amazon.com at
+// Compressed sparse row graph: the edges of vertex v are
+// targets[offsets[v] .. offsets[v + 1]), sorted by target, and so are their weights.
+// Built by builder_t.
+template <typename W = none_t, typename V = uint32_t>
+class csr_t {
+   private:
+    std::vector<size_t> m_offsets = {0};
+    std::vector<V> m_targets;
+    std::vector<W> m_weights;  // empty for none_t
 
-http://www.amazon.com/exec/obidos/ASIN/0387001638/thealgorithmrepo/
+    template <typename, typename>
+    friend class builder_t;
 
-*/
-template <uint8_t MAXV = 100, uint8_t MAXDEGREE = 50, typename T = uint8_t>
-class Graph {
-   private:
-    T m_edges[MAXV + 1][MAXDEGREE]; /* adjacency info */
-    T m_degree[MAXV + 1];           /* outdegree of each vertex */
-    T m_nvertices;                  /* number of vertices in the graph */
-    T m_nedges;                     /* number of edges in the graph */
    public:
-    Graph() : m_nvertices(0), m_nedges(0) {
-        for (auto i = 1; i <= MAXV; i++) m_degree[i] = 0;
-    }
+    V nvertices() const { return m_offsets.size() - 1; }
 
-    T nvertices() const {
-        return m_nvertices;
-    }
+    size_t nedges() const { return m_targets.size(); }
 
-    T nedges() const {
-        return m_nedges;
+    size_t degree(V v) const {
+        assert(v < nvertices());
+        return m_offsets[v + 1] - m_offsets[v];
     }
 
-    T degree(T x) const {
-        assert(x > 0);
-        assert(x <= MAXV);
-        return m_degree[x];
+    std::span<const V> edges(V v) const {
+        assert(v < nvertices());
+        return std::span(m_targets).subspan(m_offsets[v], degree(v));
     }
 
-    std::span<const T> edges(T x) const {
-        assert(x > 0);
-        assert(x <= MAXV);
-        return std::span(m_edges[x], m_degree[x]);
+    std::span<const W> weights(V v) const
+        requires(!std::is_same_v<W, none_t>)
+    {
+        assert(v < nvertices());
+        return std::span(m_weights).subspan(m_offsets[v], degree(v));
     }
+};
 
-    void insert_edge(T x, T y, bool directed) {
-        assert(x > 0);
-        assert(y > 0);
-        assert(m_degree[x] <= MAXDEGREE);
+// Collects an edge list and turns it into a csr_t.
+template <typename W = none_t, typename V = uint32_t>
+class builder_t {
+   private:
+    struct edge_t {
+        V from, to;
+        [[no_unique_address]] W weight;
+    };
+    struct adjacent_t {
+        V to;
+        [[no_unique_address]] W weight;
+        auto operator<=>(const adjacent_t &) const = default;
+    };
+
+    std::vector<edge_t> m_edges;
+    V m_nvertices = 0;
+
+    // below this many edges per thread, threads are not worth it
+    static constexpr size_t MIN_EDGES_PER_THREAD = 1 << 16;
 
-        m_nvertices = std::max(x, y);
+   public:
+    // Vertices are 0 .. n - 1, with n at least one more than the largest vertex of any edge.
+    void reserve_vertices(V n) { m_nvertices = std::max(m_nvertices, n); }
 
-        m_edges[x][m_degree[x]] = y;
-        m_degree[x]++;
+    void reserve_edges(size_t n) { m_edges.reserve(n); }
 
-        if (!directed)
-            insert_edge(y, x, true);
-        else
-            m_nedges++;
+    void add_edge(V from, V to, W weight = {}, bool directed = true) {
+        m_edges.push_back({from, to, weight});
+        if (!directed) m_edges.push_back({to, from, weight});
+        m_nvertices = std::max({m_nvertices, static_cast<V>(from + 1), static_cast<V>(to + 1)});
     }
 
-    bool delete_edge(int x, int y, bool directed) {
-        assert(x > 0);
-        assert(y > 0);
-        for (T i = 0; i < m_degree[x]; i++)
-            if (m_edges[x][i] == y) {
-                m_degree[x]--;
-                m_edges[x][i] = m_edges[x][m_degree[x]];
+    // With `dedup`, parallel edges are merged into the one with the smallest weight.
+    // The edge lists are sorted (and deduplicated) with up to `threads` threads.
+    csr_t<W, V> build(bool dedup = true, unsigned threads = available_threads()) {
+        const V n = m_nvertices;
 
-                if (!directed)
-                    (void)delete_edge(y, x, true);
+        // counting sort by source vertex
+        std::vector<size_t> offsets(n + 1, 0);
+        for (auto &e : m_edges) offsets[e.from + 1]++;
+        for (V v = 0; v < n; v++) offsets[v + 1] += offsets[v];
 
-                return true;
+        std::vector<adjacent_t> adjacent(m_edges.size());
+        {
+            std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+            for (auto &e : m_edges) adjacent[next[e.from]++] = {e.to, e.weight};
+        }
+        m_edges = {};
+
+        // sort each edge list, vertices split into ranges of about the same number of edges
+        std::vector<size_t> degree(n);
+        auto sort_range = [&](V first, V last) {
+            for (V v = first; v < last; v++) {
+                auto begin = adjacent.begin() + offsets[v], end = adjacent.begin() + offsets[v + 1];
+                std::sort(begin, end);
+                if (dedup) end = std::unique(begin, end, [](auto &a, auto &b) { return a.to == b.to; });
+                degree[v] = end - begin;
             }
+        };
+
+        threads = std::clamp<size_t>(adjacent.size() / MIN_EDGES_PER_THREAD, 1, std::max(threads, 1u));
+        if (threads == 1) {
+            sort_range(0, n);
+        } else {
+            std::vector<std::thread> workers;
+            V first = 0;
+            for (unsigned t = 1; t <= threads; t++) {
+                const size_t target = adjacent.size() * t / threads;
+                V last = t == threads ? n : std::upper_bound(offsets.begin(), offsets.end(), target) - offsets.begin() - 1;
+                last = std::max(first, last);
+                workers.emplace_back(sort_range, first, last);
+                first = last;
+            }
+            for (auto &w : workers) w.join();
+        }
 
-        return false;
-    }
-
-    friend std::ostream& operator<<(std::ostream& os, const Graph& g) {
-        for (T i = 1; i <= g.m_nvertices; i++) {
-            os << +i << " :";
-            for (T j = 0; j < g.m_degree[i]; j++)
-                os << " " << +g.m_edges[i][j];
-            os << std::endl;
+        csr_t<W, V> g;
+        g.m_offsets.resize(n + 1);
+        g.m_offsets[0] = 0;
+        for (V v = 0; v < n; v++) g.m_offsets[v + 1] = g.m_offsets[v] + degree[v];
+
+        g.m_targets.resize(g.m_offsets[n]);
+        if constexpr (!std::is_same_v<W, none_t>) g.m_weights.resize(g.m_offsets[n]);
+        for (V v = 0; v < n; v++) {
+            for (size_t i = 0; i < degree[v]; i++) {
+                const auto &a = adjacent[offsets[v] + i];
+                g.m_targets[g.m_offsets[v] + i] = a.to;
+                if constexpr (!std::is_same_v<W, none_t>) g.m_weights[g.m_offsets[v] + i] = a.weight;
+            }
         }
-        return os;
+        m_nvertices = 0;
+        return g;
     }
 };
 
 }  // namespace graph
+
+#endif
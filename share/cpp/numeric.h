@@ -2,6 +2,9 @@
 #define _AOC_NUMERIC
 
 #include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <string>
 
 template <typename T>
 T fastmod(T n, T mod) {
@@ -36,4 +39,35 @@ int sgn(T val) {
     return (T(0) < val) - (val < T(0));
 }
 
+__extension__ typedef unsigned __int128 uint128_t;
+
+// Integers modulo MOD (< 2^63), e.g. for counts which would overflow otherwise.
+template <uint64_t MOD>
+struct modular {
+    uint64_t value;
+
+    constexpr modular(uint64_t v = 0) : value(v % MOD) {}
+
+    constexpr modular operator+(modular other) const { return value + other.value; }
+    constexpr modular operator*(modular other) const {
+        return static_cast<uint64_t>(static_cast<uint128_t>(value) * other.value % MOD);
+    }
+    constexpr modular &operator+=(modular other) { return *this = *this + other; }
+    constexpr modular &operator*=(modular other) { return *this = *this * other; }
+    constexpr bool operator==(const modular &) const = default;
+
+    friend std::ostream &operator<<(std::ostream &os, modular m) { return os << m.value; }
+};
+
+// Decimal representation of a 128-bit integer (which std::ostream does not support).
+inline std::string to_string(uint128_t n) {
+    std::string s;
+    do {
+        s += static_cast<char>('0' + n % 10);
+        n /= 10;
+    } while (n);
+    std::reverse(s.begin(), s.end());
+    return s;
+}
+
 #endif
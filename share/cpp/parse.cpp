@@ -1,5 +1,11 @@
 #include <span>
-#include <x86intrin.h>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "parse.h"
 
 static constexpr int INPUT_PADDING = 64;
@@ -33,6 +39,14 @@ std::span<const char> word(input_t &in, char lower_bound, char upper_bound) {
     return std::move(std::span{first, count});
 }
 
+std::span<const char> line(input_t &in) {
+    const char *first = in.s;
+    size_t count = 0;
+    while (in.len && *in.s != '\n') in.s++, in.len--, count++;
+    if (in.len) in.s++, in.len--;
+    return std::span{first, count};
+}
+
 long number(input_t &in) {
     char *endptr;
     long result = strtol(in.s, &endptr, 10);
@@ -41,42 +55,167 @@ long number(input_t &in) {
     return result;
 }
 
+// Size of the mapping backing an input of `len` bytes: the file itself plus at least
+// INPUT_PADDING zero bytes, rounded up to whole pages.
+static size_t mapping_size(ssize_t len) {
+    const size_t page = sysconf(_SC_PAGESIZE);
+    return (len + INPUT_PADDING + page - 1) / page * page;
+}
+
+// Pipes, FIFOs and devices have no size to map: read them to the end and copy the
+// bytes into an anonymous mapping of the same layout, so free_input works on both.
+static input_t read_input(int fd, const std::string &filename) {
+    std::string data;
+    char buf[1 << 16];
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror(filename.c_str());
+            exit(EXIT_FAILURE);
+        }
+        if (n == 0) break;
+        data.append(buf, n);
+    }
+
+    input_t in;
+    in.len = data.size();
+    const size_t size = mapping_size(in.len);
+    void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(base, data.data(), in.len);
+    mprotect(base, size, PROT_READ);
+
+    in.s = static_cast<char *>(base);
+    return in;
+}
+
+// Maps the file read-only (no copy) on top of a zeroed anonymous reservation, so the
+// INPUT_PADDING bytes behind the input are readable and zero: the remainder of the last
+// file page is zero-filled by the kernel and the pages beyond it are anonymous.
 input_t load_input(const std::string &filename) {
-    FILE *fp = fopen(filename.c_str(), "r");
-    if (!fp) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
         perror(filename.c_str());
         exit(EXIT_FAILURE);
     }
 
-    if (fseek(fp, 0, SEEK_END) != 0) {
-        perror("fseek");
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("fstat");
         exit(EXIT_FAILURE);
     }
 
+    if (!S_ISREG(st.st_mode)) {
+        input_t in = read_input(fd, filename);
+        close(fd);
+        return in;
+    }
+
     input_t in;
-    in.len = ftell(fp);
-    in.s = new char[in.len + INPUT_PADDING];
-    std::fill(in.s + in.len, in.s + in.len + INPUT_PADDING, 0);
+    in.len = st.st_size;
+    const size_t size = mapping_size(in.len);
 
-    rewind(fp);
-    if (fread(in.s, in.len, 1, fp) != 1) {
-        perror("fread");
+    void *base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    if (in.len && mmap(base, in.len, PROT_READ, MAP_PRIVATE | MAP_FIXED | MAP_POPULATE, fd, 0) == MAP_FAILED) {
+        perror("mmap");
         exit(EXIT_FAILURE);
     }
-    fclose(fp);
+    close(fd);
 
+    in.s = static_cast<char *>(base);
     return in;
 }
 
 void free_input(input_t &input) {
-    delete[] input.s;
+    munmap(input.s, mapping_size(input.len));
 }
 
-// Extract the high bits after shifting each of the next eight bytes left
-inline int octet(input_t &in, int shift) {
-    auto m = *reinterpret_cast<__m64 *>(in.s);
-    parse::skip(in, 8);
-    return _mm_movemask_pi8(_mm_slli_si64(m, shift));  // SSE
+stream_t open_stream(int fd, size_t chunk_size, size_t chunks) {
+    assert(chunks >= 2);
+    stream_t st;
+    st.fd = fd;
+    st.chunk_size = chunk_size;
+    st.capacity = chunk_size * chunks;
+    st.buf = new char[st.capacity + INPUT_PADDING];
+    st.eof = false;
+    st.in = {st.buf, 0};
+    return st;
+}
+
+void close_stream(stream_t &st) {
+    delete[] st.buf;
+    st.buf = nullptr;
+    st.in = {nullptr, 0};
+}
+
+// Moves the unread bytes to the front and fills the rest of the buffer chunk by chunk.
+// Returns false if there is nothing left to read.
+bool refill(stream_t &st) {
+    if (st.eof) return st.in.len > 0;
+
+    memmove(st.buf, st.in.s, st.in.len);
+    st.in.s = st.buf;
+    while (static_cast<size_t>(st.in.len) < st.capacity) {
+        ssize_t n = read(st.fd, st.buf + st.in.len, std::min(st.chunk_size, st.capacity - st.in.len));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("read");
+            exit(EXIT_FAILURE);
+        }
+        if (n == 0) {
+            st.eof = true;
+            break;
+        }
+        st.in.len += n;
+    }
+    std::fill(st.buf + st.in.len, st.buf + st.in.len + INPUT_PADDING, 0);
+    return st.in.len > 0;
+}
+
+// Makes sure that at least one chunk is buffered (unless the stream ends before).
+static void lookahead(stream_t &st) {
+    if (st.in.len < static_cast<ssize_t>(st.chunk_size) && !st.eof) refill(st);
+}
+
+void skip(stream_t &st, int n) {
+    while (n) {
+        if (!more(st)) abort();
+        int k = std::min<ssize_t>(n, st.in.len);
+        st.in.s += k, st.in.len -= k;
+        n -= k;
+    }
+}
+
+void skip_whitespace(stream_t &st) {
+    while (more(st) && *st.in.s == ' ') st.in.s++, st.in.len--;
+}
+
+void seek_next_line(stream_t &st) {
+    while (more(st) && *st.in.s != '\n') st.in.s++, st.in.len--;
+    if (more(st)) st.in.s++, st.in.len--;
+}
+
+std::span<const char> word(stream_t &st, char lower_bound, char upper_bound) {
+    lookahead(st);
+    return word(st.in, lower_bound, upper_bound);
+}
+
+std::span<const char> line(stream_t &st) {
+    auto eol = static_cast<char *>(memchr(st.in.s, '\n', st.in.len));
+    if (!eol && !st.eof) {
+        refill(st);
+        eol = static_cast<char *>(memchr(st.in.s, '\n', st.in.len));
+        if (!eol && !st.eof) abort();  // line does not fit into the buffer
+    }
+    return line(st.in);
 }
 
 }  // namespace parse
@@ -2,8 +2,14 @@
 #define _AOC_PARSE_H
 
 #include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <span>
 #include <string>
 #include <sstream>
+#include <type_traits>
+#include <immintrin.h>
 
 namespace parse {
 
@@ -12,6 +18,21 @@ struct input_t {
     ssize_t len;
 };
 
+// Streaming input: a fixed buffer of `chunks` chunks over a file descriptor (or pipe).
+// Once the unread part runs low, it is moved to the front of the buffer and the freed
+// chunks are refilled, so memory stays bounded regardless of the input size.
+// `in` is the buffered, unread part of the stream. Spans returned by word() and line()
+// point into the buffer and are valid until the next call; tokens must fit into a
+// chunk and lines into the whole buffer.
+struct stream_t {
+    int fd;
+    char *buf;
+    size_t chunk_size;
+    size_t capacity;
+    bool eof;
+    input_t in;
+};
+
 struct output_t {
     std::array<std::string, 2> answer;
 
@@ -32,16 +53,36 @@ struct output_t {
 input_t load_input(const std::string &filename);
 void free_input(input_t &input);
 
+stream_t open_stream(int fd, size_t chunk_size = 1 << 16, size_t chunks = 4);
+void close_stream(stream_t &st);  // does not close the file descriptor
+bool refill(stream_t &st);
+
+// The helpers below accept both an input_t and a stream_t, so single-pass days can be
+// written once for both (see e.g. day02).
+inline bool more(const input_t &in) { return in.len > 0; }
+inline bool more(stream_t &st) { return st.in.len > 0 || refill(st); }
+// The next character (without consuming it), zero at the end of the input.
+inline char peek(const input_t &in) { return in.len > 0 ? *in.s : 0; }
+inline char peek(stream_t &st) { return more(st) ? *st.in.s : 0; }
+
 void skip(input_t &in, int n);
+void skip(stream_t &st, int n);
 void skip_whitespace(input_t &in);
+void skip_whitespace(stream_t &st);
 void seek_next_line(input_t &in);
+void seek_next_line(stream_t &st);
 std::span<const char> word(input_t &in, char lower_bound, char upper_bound);
+std::span<const char> word(stream_t &st, char lower_bound, char upper_bound);
+// The remainder of the current line (without the newline, which is consumed).
+std::span<const char> line(input_t &in);
+std::span<const char> line(stream_t &st);
 long number(input_t &in);
 
 template <typename T>
 T positive(input_t &in) {
     bool have = false;
-    for (T n = 0; in.len; in.s++, in.len--) {
+    T n = 0;
+    for (; in.len; in.s++, in.len--) {
         uint8_t d = *in.s - '0';
         if (d <= 9) {
             n = 10 * n + d;
@@ -50,7 +91,23 @@ T positive(input_t &in) {
             return n;
         }
     }
-    return 0;
+    return n;
+}
+
+template <typename T>
+T positive(stream_t &st) {
+    bool have = false;
+    T n = 0;
+    for (; more(st); st.in.s++, st.in.len--) {
+        uint8_t d = *st.in.s - '0';
+        if (d <= 9) {
+            n = 10 * n + d;
+            have = true;
+        } else if (have) {
+            return n;
+        }
+    }
+    return n;
 }
 
 // Fixed-width positive integer.
@@ -72,8 +129,214 @@ T positive(input_t &in, int len, bool strict) {
     return n;
 }
 
+namespace detail {
+
+// Bitmask of the bytes in [s, s + 16) which are decimal digits.
+inline uint32_t digit_mask16(const char *s) {
+#ifdef __SSE2__
+    __m128i v = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s)), _mm_set1_epi8('0'));
+    // unsigned v <= 9
+    __m128i le9 = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(9)), v);
+    return _mm_movemask_epi8(le9);
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < 16; i++) mask |= static_cast<uint32_t>(static_cast<uint8_t>(s[i] - '0') <= 9) << i;
+    return mask;
+#endif
+}
+
+// Bitmask of the bytes in [s, s + 32) which are decimal digits.
+inline uint32_t digit_mask32(const char *s) {
+#ifdef __AVX2__
+    __m256i v = _mm256_sub_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(s)), _mm256_set1_epi8('0'));
+    __m256i le9 = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(9)), v);
+    return _mm256_movemask_epi8(le9);
+#else
+    return digit_mask16(s) | digit_mask16(s + 16) << 16;
+#endif
+}
+
+#ifdef __SSE4_1__
+// pshufb masks which right-align the first `len` bytes in a register and zero the rest.
+struct align_table {
+    alignas(16) int8_t mask[17][16];
+    constexpr align_table() : mask() {
+        for (int len = 0; len <= 16; len++)
+            for (int j = 0; j < 16; j++) mask[len][j] = j < 16 - len ? -128 : j - (16 - len);
+    }
+};
+inline constexpr align_table ALIGN_TABLE;
+
+// Converts the `len` (< 16) digits at s; s[0..16) must be readable.
+inline uint64_t convert16(const char *s, int len) {
+    __m128i v = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s)), _mm_set1_epi8('0'));
+    v = _mm_shuffle_epi8(v, _mm_load_si128(reinterpret_cast<const __m128i *>(ALIGN_TABLE.mask[len])));
+    // 16 x 1 digit -> 8 x 2 digits -> 4 x 4 digits -> 2 x 8 digits
+    v = _mm_maddubs_epi16(v, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+    v = _mm_madd_epi16(v, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+    v = _mm_packus_epi32(v, v);
+    v = _mm_madd_epi16(v, _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+    uint64_t hi = static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+    uint64_t lo = static_cast<uint32_t>(_mm_extract_epi32(v, 1));
+    return hi * 100000000 + lo;
+}
+#endif
+
+}  // namespace detail
+
+// Parses up to out.size() integers into out and returns how many were parsed.
+// Numbers are separated by any non-digit characters; for signed T a '-' directly in
+// front of a number negates it. The digits of 32 bytes are classified at once and
+// every number inside such a block with less than 16 digits is converted with SSE4.1
+// (pmaddubsw/pmaddwd); numbers crossing the block are retried at the next block, and
+// the last 48 bytes (and longer numbers) are parsed byte by byte.
+template <typename T>
+size_t numbers(input_t &in, std::span<T> out) {
+    static_assert(std::is_integral_v<T>);
+    size_t count = 0;
+    bool negative = false;
+
+    auto emit = [&](T n) {
+        if constexpr (std::is_signed_v<T>) {
+            if (negative) n = -n;
+        }
+        out[count++] = n;
+        negative = false;
+    };
+
+    while (count < out.size()) {
+#ifdef __SSE4_1__
+        if (in.len >= 48) {
+            const uint32_t mask = detail::digit_mask32(in.s);
+            uint32_t starts = mask & ~(mask << 1);
+            int consumed = 32;
+            while (starts && count < out.size()) {
+                const int start = std::countr_zero(starts);
+                starts &= starts - 1;
+                const int len = std::countr_zero(~(mask >> start));  // bits above 31 are zero
+                if (start + len == 32 || len >= 16) {
+                    // may continue in the next block
+                    consumed = start;
+                    break;
+                }
+                if (start) negative = in.s[start - 1] == '-';
+                emit(static_cast<T>(detail::convert16(in.s + start, len)));
+                consumed = start + len;
+            }
+            if (consumed) {
+                negative = in.s[consumed - 1] == '-';
+                in.s += consumed, in.len -= consumed;
+                continue;
+            }
+            // a number of 32 or more digits: fall through to the scalar path
+        }
+#endif
+        while (in.len && static_cast<uint8_t>(*in.s - '0') > 9) {
+            negative = *in.s == '-';
+            in.s++, in.len--;
+        }
+        if (!in.len) break;
+        T n = 0;
+        for (; in.len && static_cast<uint8_t>(*in.s - '0') <= 9; in.s++, in.len--) n = 10 * n + (*in.s - '0');
+        emit(n);
+    }
+
+    return count;
+}
+
+// Bit planes: the characters of a grid row (e.g. '0'/'1', '#'/'.' or '>'/'v')
+// compressed into an integer with one bit per character, 16/32 bytes per movemask.
+
+// Bit i is set iff s[i] == c, for i < 16 (s[0..16) must be readable).
+inline uint32_t eq_mask16(const char *s, char c) {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s)), _mm_set1_epi8(c)));
+}
+
+// Bit i is set iff s[i] == c, for i < 32 (s[0..32) must be readable).
+inline uint32_t eq_mask32(const char *s, char c) {
+#ifdef __AVX2__
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(s)), _mm256_set1_epi8(c)));
+#else
+    return eq_mask16(s, c) | eq_mask16(s + 16, c) << 16;
+#endif
+}
+
+namespace detail {
+
+#ifdef __SSSE3__
+// Bit 15 - i is set iff s[i] == c, for i < 16 (s[0..16) must be readable).
+inline uint32_t eq_mask16_reversed(const char *s, char c) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+    v = _mm_shuffle_epi8(v, _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+}
+#endif
+
+template <typename T>
+constexpr T low_bits(int n) {
+    return n >= static_cast<int>(8 * sizeof(T)) ? ~T(0) : (T(1) << n) - 1;
+}
+
+}  // namespace detail
+
+// Consumes the next n (<= bits of T) characters: bit i is set iff the i-th equals `one`.
+template <typename T = uint64_t>
+T bitplane(input_t &in, int n, char one) {
+    static_assert(std::is_unsigned_v<T> && sizeof(T) <= 8);
+    assert(n <= static_cast<int>(8 * sizeof(T)) && n <= in.len);
+    uint64_t mask = 0;
+    if (n <= 16 && in.len >= 16) {
+        mask = eq_mask16(in.s, one);
+    } else if (n <= 32 && in.len >= 32) {
+        mask = eq_mask32(in.s, one);
+    } else if (in.len >= 64) {
+        mask = eq_mask32(in.s, one) | static_cast<uint64_t>(eq_mask32(in.s + 32, one)) << 32;
+    } else {
+        for (int i = 0; i < n; i++) mask |= static_cast<uint64_t>(in.s[i] == one) << i;
+    }
+    in.s += n, in.len -= n;
+    return static_cast<T>(mask) & detail::low_bits<T>(n);
+}
+
+// Like bitplane, but the first character becomes the most significant bit, i.e.
+// binary<uint16_t>(in, 5) is 0b10110 for "10110".
+template <typename T = uint64_t>
+T binary(input_t &in, int n, char one = '1') {
+    static_assert(std::is_unsigned_v<T> && sizeof(T) <= 8);
+    assert(n <= static_cast<int>(8 * sizeof(T)) && n <= in.len);
+    uint64_t value = 0;
+#ifdef __SSSE3__
+    const int blocks = (n + 15) / 16;
+    if (in.len >= 16 * blocks) {
+        for (int b = 0; b < blocks; b++) value = value << 16 | detail::eq_mask16_reversed(in.s + 16 * b, one);
+        value >>= 16 * blocks - n;
+        in.s += n, in.len -= n;
+        return static_cast<T>(value);
+    }
+#endif
+    for (int i = 0; i < n; i++) value = value << 1 | (in.s[i] == one);
+    in.s += n, in.len -= n;
+    return static_cast<T>(value);
+}
+
+template <typename T = uint64_t>
+T bitplane(stream_t &st, int n, char one) {
+    if (st.in.len < 64) refill(st);
+    return bitplane<T>(st.in, n, one);
+}
+
+template <typename T = uint64_t>
+T binary(stream_t &st, int n, char one = '1') {
+    if (st.in.len < 64) refill(st);
+    return binary<T>(st.in, n, one);
+}
+
 // Extract the high bits after shifting each of the next eight bytes left
-inline int octet(input_t &in, int shift);
+inline int octet(input_t &in, int shift) {
+    __m128i m = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in.s));
+    skip(in, 8);
+    return _mm_movemask_epi8(_mm_sll_epi64(m, _mm_cvtsi32_si128(shift))) & 0xff;
+}
 
 }  // namespace parse
 
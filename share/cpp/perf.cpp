@@ -0,0 +1,92 @@
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+
+#include "perf.h"
+
+namespace perf {
+
+static constexpr uint64_t cache_config(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+static int open_counter(counter_t c) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.inherit = 1;  // include threads spawned by a day (e.g. day23)
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (c) {
+        case CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cache_config(PERF_COUNT_HW_CACHE_L1D);
+            break;
+        case LLC_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cache_config(PERF_COUNT_HW_CACHE_LL);
+            break;
+        case BRANCH_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        default:
+            return -1;
+    }
+
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+counters_t::counters_t() {
+    for (int c = 0; c < COUNTER_COUNT; c++) m_fds[c] = open_counter(static_cast<counter_t>(c));
+}
+
+counters_t::~counters_t() {
+    for (auto fd : m_fds)
+        if (fd >= 0) close(fd);
+}
+
+bool counters_t::available() const {
+    for (auto fd : m_fds)
+        if (fd >= 0) return true;
+    return false;
+}
+
+void counters_t::start() {
+    for (auto fd : m_fds) {
+        if (fd < 0) continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+sample_t counters_t::stop() {
+    for (auto fd : m_fds)
+        if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+    sample_t sample;
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        if (m_fds[c] < 0) continue;
+        uint64_t buf[3];  // value, time enabled, time running
+        if (read(m_fds[c], buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0) continue;
+        // scale up if the PMU was multiplexed
+        sample.value[c] = buf[2] < buf[1] ? static_cast<uint64_t>(static_cast<double>(buf[0]) * buf[1] / buf[2]) : buf[0];
+        sample.valid[c] = true;
+    }
+    return sample;
+}
+
+}  // namespace perf
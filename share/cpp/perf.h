@@ -0,0 +1,59 @@
+#ifndef _AOC_PERF_H
+#define _AOC_PERF_H
+
+#include <array>
+#include <cstdint>
+
+// Hardware performance counters via Linux perf_event_open(2).
+//
+// Counters which cannot be opened (no PMU, perf_event_paranoid, containers, ...)
+// are simply reported as invalid.
+namespace perf {
+
+enum counter_t {
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    COUNTER_COUNT,
+};
+
+struct sample_t {
+    std::array<uint64_t, COUNTER_COUNT> value{};
+    std::array<bool, COUNTER_COUNT> valid{};
+
+    // instructions per cycle, or a negative value if unknown
+    double ipc() const {
+        if (!valid[CYCLES] || !valid[INSTRUCTIONS] || !value[CYCLES]) return -1;
+        return static_cast<double>(value[INSTRUCTIONS]) / value[CYCLES];
+    }
+
+    // events per 1000 instructions, or a negative value if unknown
+    double mpki(counter_t c) const {
+        if (!valid[c] || !valid[INSTRUCTIONS] || !value[INSTRUCTIONS]) return -1;
+        return 1000.0 * value[c] / value[INSTRUCTIONS];
+    }
+};
+
+// Counts the calling thread and all threads it spawns while enabled.
+class counters_t {
+   private:
+    std::array<int, COUNTER_COUNT> m_fds;
+
+   public:
+    counters_t();
+    ~counters_t();
+    counters_t(const counters_t &) = delete;
+    counters_t &operator=(const counters_t &) = delete;
+
+    // true if at least one counter could be opened
+    bool available() const;
+
+    void start();
+    sample_t stop();
+};
+
+}  // namespace perf
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _AOC_POOL_H
+#define _AOC_POOL_H
+
+// Threads a day may use for itself: one while it runs next to other days (--jobs),
+// otherwise one per core. Defined by the runner in aoc.cpp.
+unsigned available_threads();
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _AOC_TESTING_H
+#define _AOC_TESTING_H
+
+// Helpers for the tests (IS_TEST), not part of the days' builds.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <unistd.h>
+
+#include "parse.h"
+
+// Runs `solve` over `text`, streamed from a temporary file through a buffer of `chunks`
+// chunks of `chunk_size` bytes. Tests use tiny chunks, so that tokens and lines straddle
+// chunk boundaries.
+inline parse::output_t solve_streamed(std::string_view text, parse::output_t (*solve)(parse::stream_t &),
+                                      size_t chunk_size, size_t chunks = 4) {
+    FILE *file = tmpfile();
+    if (!file || fwrite(text.data(), 1, text.size(), file) != text.size() || fflush(file) != 0) {
+        perror("tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    if (lseek(fileno(file), 0, SEEK_SET) != 0) {
+        perror("lseek");
+        exit(EXIT_FAILURE);
+    }
+
+    auto st = parse::open_stream(fileno(file), chunk_size, chunks);
+    auto output = solve(st);
+    parse::close_stream(st);
+    fclose(file);
+    return output;
+}
+
+#endif
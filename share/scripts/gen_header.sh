@@ -17,7 +17,14 @@ echo "$days_raw" | while read -r day; do
     day_numeric=${day##day}
     day_numeric=${day_numeric##0}
     if [ -n "$day" ]; then
-        printf "    { %s, advent_t{%s} },\n" "$day_numeric" "$day"
+        # optional hooks, see advent_t
+        hooks=""
+        for hook in stream; do
+            if grep -q " ${day}_${hook}(" "$source_root/include/$day.h"; then
+                hooks="$hooks, .$hook = ${day}_${hook}"
+            fi
+        done
+        printf "    { %s, advent_t{.fn = %s%s} },\n" "$day_numeric" "$day" "$hooks"
     fi
 done
 echo '};'
@@ -2,52 +2,31 @@
 
 using parse::input_t;
 
-parse::output_t day01(input_t in) {
+template <typename Input>
+static parse::output_t solve(Input &in) {
     long part1 = 0, part2 = 0;
 
-    std::array<int, 2048> numbers;
-    numbers.fill(0);
-    size_t numbers_idx = 0;
+    // The last depths. Two neighbouring windows share two depths, so the sum
+    // increases iff the new depth is larger than the one three positions back.
+    std::array<long, 4> depths;
+    depths.fill(0);
 
-    long old = parse::positive<long>(in);
-    parse::skip_whitespace(in);
-    numbers[numbers_idx] = old;
-    numbers_idx++;
-
-    // first element of the window
-    long window = old;
-
-    for (size_t i = 0; i < 2; i++) {
+    for (size_t n = 0; parse::more(in); n++) {
         long current = parse::positive<long>(in);
-        parse::skip_whitespace(in);
-        numbers[numbers_idx] = current;
-        numbers_idx++;
-        if (current > old) part1++;
-        old = current;
-
-        window += current;
-    }
-    // first window is complete
+        parse::seek_next_line(in);
 
-    while (in.len) {
-        long current = parse::positive<long>(in);
-        parse::skip_whitespace(in);
-        numbers[numbers_idx] = current;
-        numbers_idx++;
-        if (current > old) part1++;
-        old = current;
-
-        auto first = numbers[numbers_idx - 4];
-        long next_window = window - first + current;
-        if (next_window > window) {
-            part2++;
-        }
-        window = next_window;
+        if (n >= 1 && current > depths[(n - 1) % 4]) part1++;
+        if (n >= 3 && current > depths[(n - 3) % 4]) part2++;
+        depths[n % 4] = current;
     }
 
     return {part1, part2};
 }
 
+parse::output_t day01(input_t in) { return solve(in); }
+
+parse::output_t day01_stream(parse::stream_t &in) { return solve(in); }
+
 #ifdef IS_MAIN
 int main() {
     input_t in = parse::load_input("input/day01.txt");
@@ -60,6 +39,7 @@ int main() {
 #ifdef IS_TEST
 
 #include <doctest/doctest.h>
+#include <testing.h>
 
 using std::make_tuple;
 
@@ -85,6 +65,10 @@ TEST_CASE("day01: examples") {
         auto output = day01(in);
         CHECK_EQ(std::get<1>(tc), output.answer[0]);
         CHECK_EQ(std::get<2>(tc), output.answer[1]);
+
+        auto streamed = solve_streamed(first, day01_stream, 8);
+        CHECK_EQ(std::get<1>(tc), streamed.answer[0]);
+        CHECK_EQ(std::get<2>(tc), streamed.answer[1]);
     }
 }
 
@@ -2,13 +2,14 @@
 
 using parse::input_t;
 
-parse::output_t day02(input_t in) {
+template <typename Input>
+static parse::output_t solve(Input &in) {
     long part1 = 0, part2 = 0;
 
     long horizontal = 0, depth_part1 = 0;
     long depth_part2 = 0, aim = 0;
 
-    while (in.len) {
+    while (parse::more(in)) {
         auto direction = parse::word(in, 'a', 'z');
         parse::skip_whitespace(in);
         int units = parse::positive<int>(in);
@@ -37,6 +38,10 @@ parse::output_t day02(input_t in) {
     return {part1, part2};
 }
 
+parse::output_t day02(input_t in) { return solve(in); }
+
+parse::output_t day02_stream(parse::stream_t &in) { return solve(in); }
+
 #ifdef IS_MAIN
 int main() {
     input_t in = parse::load_input("input/day02.txt");
@@ -49,6 +54,7 @@ int main() {
 #ifdef IS_TEST
 
 #include <doctest/doctest.h>
+#include <testing.h>
 
 using std::make_tuple;
 
@@ -70,6 +76,10 @@ TEST_CASE("day02 examples") {
         auto output = day02(in);
         CHECK_EQ(std::get<1>(tc), output.answer[0]);
         CHECK_EQ(std::get<2>(tc), output.answer[1]);
+
+        auto streamed = solve_streamed(first, day02_stream, 8);
+        CHECK_EQ(std::get<1>(tc), streamed.answer[0]);
+        CHECK_EQ(std::get<2>(tc), streamed.answer[1]);
     }
 }
 
@@ -2,59 +2,69 @@
 
 using parse::input_t;
 
-struct counter {
-    size_t zeroes;
-    size_t ones;
-};
-
-std::ostream& operator<<(std::ostream& os, const counter& c) {
-    os << "{zeroes: " << c.zeroes << ", ones: " << c.ones << "}";
-    return os;
+// Readings are at most 16 bits wide, so the report is kept as a histogram of their
+// values instead of a list of readings. The bit counts come from runs of it, and the
+// readings sharing their top bits are a contiguous range of values, so a rating is a
+// binary search over its prefix sums.
+// histogram[x] is the number of readings equal to x, for x below 2^n.
+using histogram_t = std::vector<uint32_t>;
+
+// Number of ones in each of the lowest `n` bit positions of all readings.
+static std::array<size_t, 16> count_ones(const histogram_t &histogram, size_t n) {
+    std::array<size_t, 16> ones;
+    ones.fill(0);
+    for (size_t b = 0; b < n; b++) {
+        // the values with bit b set come in runs of 2^b
+        for (size_t x = 1 << b; x < histogram.size(); x += 2 << b) {
+            ones[b] += std::accumulate(histogram.begin() + x, histogram.begin() + x + (1 << b), size_t{0});
+        }
+    }
+    return ones;
 }
 
-parse::output_t day03(input_t in) {
+// Narrows the report down to a single reading. The values in [first, last) share all
+// bits above b, so the ones with bit b set are the upper half of the range; `below[x]`
+// counts the readings less than x. `keep_ones(zeroes, ones)` decides which half survives.
+template <typename F>
+static uint16_t rating(const std::vector<uint32_t> &below, size_t n, F keep_ones) {
+    uint32_t first = 0, last = 1 << n;
+    for (size_t b = n; b-- > 0;) {
+        const uint32_t mid = first + (1 << b);
+        const uint32_t zeroes = below[mid] - below[first], ones = below[last] - below[mid];
+        if (ones && (!zeroes || keep_ones(zeroes, ones))) {
+            first = mid;
+        } else {
+            last = mid;
+        }
+    }
+    return first;
+}
+
+template <typename Input>
+static parse::output_t solve(Input &in) {
     long part1 = 0, part2 = 0;
 
-    std::array<counter, 16> counters;
-    counters.fill(counter());
-
-    size_t n = 0;  // number of digits in a number
-
-    std::unordered_set<int> oxygen_numbers;
-    oxygen_numbers.reserve(1024);
-
-    {
-        long current = 0;
-        size_t idx = 0;
-        while (in.len) {
-            switch (*in.s) {
-                case '0':
-                    counters[idx].zeroes++;
-                    idx++;
-                    current <<= 1;
-                    break;
-                case '1':
-                    current |= 1;
-                    current <<= 1;
-                    counters[idx].ones++;
-                    idx++;
-                    break;
-                case '\n':
-                    current >>= 1;
-                    oxygen_numbers.insert(current);
-                    current = 0;
-                    n = idx;
-                    idx = 0;
-            }
-            in.s++, in.len--;
+    // the first line determines the width of the report
+    auto first = parse::line(in);
+    const size_t n = first.size();
+    assert(n > 0 && n <= 16);
+    input_t first_in = {const_cast<char *>(first.data()), static_cast<ssize_t>(n)};
+
+    histogram_t histogram(1 << n, 0);
+    size_t count = 1;
+    histogram[parse::binary<uint16_t>(first_in, n)]++;
+    while (parse::more(in)) {
+        if (parse::peek(in) != '\n') {  // skip blank lines, e.g. at the end
+            histogram[parse::binary<uint16_t>(in, n)]++;
+            count++;
         }
+        parse::seek_next_line(in);
     }
 
+    auto ones = count_ones(histogram, n);
     long gamma_rate = 0, epsilon_rate = 0;
-    for (size_t i = 0; i < n; i++) {
-        auto bit_pos = n - 1 - i;
-        auto counter = counters[i];
-        if (counter.ones > counter.zeroes) {
+    for (size_t bit_pos = 0; bit_pos < n; bit_pos++) {
+        if (ones[bit_pos] > count - ones[bit_pos]) {
             gamma_rate |= 1 << bit_pos;
         } else {
             epsilon_rate |= 1 << bit_pos;
@@ -63,81 +73,23 @@ parse::output_t day03(input_t in) {
 
     part1 = gamma_rate * epsilon_rate;
 
-    auto co2_numbers = oxygen_numbers;  // copy
-
-    // oxygen generator rating: most common
-    for (size_t i = 0; i < n; i++) {
-        long ones = 0;
-        long zeroes = 0;
-
-        // update counters
-        for (auto x : oxygen_numbers) {
-            auto is_set = x & (1 << (n - 1 - i));
-            if (is_set) {
-                ones++;
-            } else {
-                zeroes++;
-            }
-        }
+    std::vector<uint32_t> below(histogram.size() + 1, 0);
+    std::partial_sum(histogram.begin(), histogram.end(), below.begin() + 1);
 
-        for (auto it = oxygen_numbers.begin(); it != oxygen_numbers.end() && oxygen_numbers.size() > 1;) {
-            // on parity, one wins
-            int x = *it;
-            if (x & (1 << (n - 1 - i))) {
-                if (zeroes > ones) {
-                    it = oxygen_numbers.erase(it);
-                    continue;
-                }
-            } else {
-                if (ones >= zeroes) {
-                    it = oxygen_numbers.erase(it);
-                    continue;
-                }
-            }
-            it++;
-        }
+    // oxygen generator rating: most common, on parity one wins
+    long oxygen = rating(below, n, [](auto zeroes, auto ones) { return ones >= zeroes; });
+    // CO2 scrubber rating: least common, on parity zero wins
+    long co2 = rating(below, n, [](auto zeroes, auto ones) { return ones < zeroes; });
 
-    }
-
-    // CO2 scrubber rating: least common; partiy => zero wins
-    for (size_t i = 0; i < n; i++) {
-        long ones = 0;
-        long zeroes = 0;
-
-        // update counters
-        for (auto x : co2_numbers) {
-            auto is_set = x & (1 << (n - 1 - i));
-            if (is_set) {
-                ones++;
-            } else {
-                zeroes++;
-            }
-        }
-
-        for (auto it = co2_numbers.begin(); it != co2_numbers.end() && co2_numbers.size() > 1;) {
-            // on parity, zero wins
-            int x = *it;
-            if (x & (1 << (n - 1 - i))) {
-                if (zeroes <= ones) {
-                    it = co2_numbers.erase(it);
-                    continue;
-                }
-            } else {
-                if (ones < zeroes) {
-                    it = co2_numbers.erase(it);
-                    continue;
-                }
-            }
-            it++;
-        }
-
-    }
-
-    part2 = *oxygen_numbers.begin() * *co2_numbers.begin();
+    part2 = oxygen * co2;
 
     return {part1, part2};
 }
 
+parse::output_t day03(input_t in) { return solve(in); }
+
+parse::output_t day03_stream(parse::stream_t &in) { return solve(in); }
+
 #ifdef IS_MAIN
 int main() {
     input_t in = parse::load_input("input/day03.txt");
@@ -150,6 +102,7 @@ int main() {
 #ifdef IS_TEST
 
 #include <doctest/doctest.h>
+#include <testing.h>
 
 using std::make_tuple;
 
@@ -168,6 +121,8 @@ TEST_CASE("day03 examples") {
                    "00010\n"
                    "01010\n",
                    "198", "230"),
+        make_tuple("00100\n11110\n10110\n10111\n10101\n01111\n00111\n11100\n10000\n11001\n00010\n01010\n\n\n",
+                   "198", "230"),
     };
 
     for (auto& tc : test_cases) {
@@ -177,6 +132,10 @@ TEST_CASE("day03 examples") {
         auto output = day03(in);
         CHECK_EQ(std::get<1>(tc), output.answer[0]);
         CHECK_EQ(std::get<2>(tc), output.answer[1]);
+
+        auto streamed = solve_streamed(first, day03_stream, 8);
+        CHECK_EQ(std::get<1>(tc), streamed.answer[0]);
+        CHECK_EQ(std::get<2>(tc), streamed.answer[1]);
     }
 }
 
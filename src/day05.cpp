@@ -2,62 +2,106 @@
 
 using parse::input_t;
 
-constexpr size_t WIDTH = 1000;
-constexpr size_t HEIGHT = 1000;
-
-static short board[WIDTH][HEIGHT];
-static short board2[WIDTH][HEIGHT];
-
-parse::output_t day05(input_t in) {
-    long part1 = 0, part2 = 0;
-
-    while (in.len >= 10) {
-        auto x1 = parse::positive<short>(in);
-        in.s++;
-        in.len--;
-        auto y1 = parse::positive<short>(in);
-        in.s += 4;
-        in.len -= 4;
-        auto x2 = parse::positive<short>(in);
-        in.s++;
-        in.len--;
-        auto y2 = parse::positive<short>(in);
-
-        if (x1 == x2) {
-            for (int i = std::min(y1, y2); i <= std::max(y1, y2); i++) {
-                board[x1][i]++;
-                board2[x1][i]++;
-            }
-        } else if (y1 == y2) {
-            for (int i = std::min(x1, x2); i <= std::max(x1, x2); i++) {
-                board[i][y1]++;
-                board2[i][y1]++;
+// A segment as seen by a sweep over the rows: it covers the x coordinates
+// [x, x + width] in row y_first and moves by dx per row until row y_last.
+struct segment_t {
+    int32_t y_first, y_last;
+    int32_t x, width;
+    int32_t dx;  // 0 (horizontal/vertical) or +-1 (diagonal)
+    bool diagonal;
+};
+
+// Counts the points of row y covered by at least two segments, for part 1 (without
+// diagonals) and part 2. `crossing` holds the vertical and diagonal segments crossing
+// the row sorted by x, `events` the starts (+1) and ends (-1) of the horizontal
+// segments on the row.
+static void count_row(const std::vector<segment_t> &crossing, std::vector<std::pair<int32_t, int>> &events,
+                      long &part1, long &part2) {
+    std::sort(events.begin(), events.end());
+
+    int cover = 0;             // horizontal segments covering the current x
+    int32_t covered_from = 0;  // start of the current run with cover >= 2
+    size_t i = 0, j = 0;
+    while (i < crossing.size() || j < events.size()) {
+        if (j < events.size() && (i == crossing.size() || events[j].first <= crossing[i].x)) {
+            auto [x, delta] = events[j++];
+            if (cover < 2 && cover + delta >= 2) covered_from = x;
+            if (cover >= 2 && cover + delta < 2) {
+                part1 += x - covered_from;
+                part2 += x - covered_from;
             }
+            cover += delta;
         } else {
-            if (x2 - x1 == y2 - y1 || x1 - x2 == y2 - y1) {
-                short dx = x1 < x2 ? 1 : -1;
-                short dy = y1 < y2 ? 1 : -1;
-                while (x1 != x2 && y1 != y2) {
-                    board2[x1][y1]++;
-                    x1 += dx;
-                    y1 += dy;
-                }
-                board2[x1][y1]++;
+            const int32_t x = crossing[i].x;
+            int straight = 0, all = 0;
+            for (; i < crossing.size() && crossing[i].x == x; i++) {
+                straight += !crossing[i].diagonal;
+                all++;
+            }
+            if (cover < 2) {  // otherwise already counted as part of the run
+                if (cover + straight >= 2) part1++;
+                if (cover + all >= 2) part2++;
             }
         }
+    }
+}
 
-        while (in.len > 0 && *in.s < '0' && *in.s > '9') {
-            in.s++;
-            in.len--;
+parse::output_t day05(input_t in) {
+    long part1 = 0, part2 = 0;
+
+    std::vector<segment_t> horizontal, other;
+    horizontal.reserve(256);
+    other.reserve(512);
+
+    while (parse::more(in)) {
+        auto x1 = parse::positive<int32_t>(in);
+        auto y1 = parse::positive<int32_t>(in);
+        auto x2 = parse::positive<int32_t>(in);
+        auto y2 = parse::positive<int32_t>(in);
+        parse::seek_next_line(in);
+
+        if (y1 > y2) std::swap(x1, x2), std::swap(y1, y2);
+        if (y1 == y2) {
+            horizontal.push_back({y1, y1, std::min(x1, x2), std::abs(x2 - x1), 0, false});
+        } else if (x1 == x2) {
+            other.push_back({y1, y2, x1, 0, 0, false});
+        } else if (std::abs(x2 - x1) == y2 - y1) {
+            other.push_back({y1, y2, x1, 0, x1 < x2 ? 1 : -1, true});
         }
     }
 
-    // TODO: this is very inefficient; keep track where lines begin and end in each row/column
-    for (size_t i = 0; i < WIDTH; i++) {
-        for (size_t j = 0; j < HEIGHT; j++) {
-            if (board[i][j] > 1) part1++;
-            if (board2[i][j] > 1) part2++;
+    // Sweep over the rows which are covered by any segment. The segments crossing the
+    // current row stay sorted by x from one row to the next: only diagonals move, by
+    // one, so an insertion sort restores the order in close to linear time.
+    auto by_row = [](auto &a, auto &b) { return a.y_first < b.y_first; };
+    std::sort(horizontal.begin(), horizontal.end(), by_row);
+    std::sort(other.begin(), other.end(), by_row);
+
+    std::vector<segment_t> crossing;
+    std::vector<std::pair<int32_t, int>> events;
+    size_t next_h = 0, next_o = 0;
+    int32_t y = 0;
+    while (next_h < horizontal.size() || next_o < other.size() || !crossing.empty()) {
+        if (crossing.empty()) {
+            y = std::min(next_h < horizontal.size() ? horizontal[next_h].y_first : INT32_MAX,
+                         next_o < other.size() ? other[next_o].y_first : INT32_MAX);
+        }
+        for (; next_o < other.size() && other[next_o].y_first == y; next_o++) crossing.push_back(other[next_o]);
+        for (size_t i = 1; i < crossing.size(); i++) {
+            for (size_t k = i; k > 0 && crossing[k - 1].x > crossing[k].x; k--) std::swap(crossing[k - 1], crossing[k]);
+        }
+
+        events.clear();
+        for (; next_h < horizontal.size() && horizontal[next_h].y_first == y; next_h++) {
+            events.emplace_back(horizontal[next_h].x, 1);
+            events.emplace_back(horizontal[next_h].x + horizontal[next_h].width + 1, -1);
         }
+
+        count_row(crossing, events, part1, part2);
+
+        std::erase_if(crossing, [y](auto &seg) { return seg.y_last == y; });
+        for (auto &seg : crossing) seg.x += seg.dx;
+        y++;
     }
 
     return {part1, part2};
@@ -79,9 +123,6 @@ int main() {
 using std::make_tuple;
 
 TEST_CASE("day05: examples") {
-    memset(board, 0, sizeof(board));
-    memset(board2, 0, sizeof(board));
-
     auto test_cases = {
         make_tuple(
             "0,9 -> 5,9\n"
@@ -108,9 +149,6 @@ TEST_CASE("day05: examples") {
 }
 
 TEST_CASE("day05, part 1 & part 2") {
-    memset(board, 0, sizeof(board));
-    memset(board2, 0, sizeof(board));
-
     input_t in = parse::load_input("input/day05.txt");
     auto output = day05(in);
     CHECK_EQ("5442", output.answer[0]);
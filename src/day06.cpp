@@ -5,39 +5,79 @@ using parse::input_t;
 const size_t DAYS_PART1 = 80;
 const size_t DAYS_PART2 = 256;
 
-parse::output_t day06(input_t in) {
-    uint64_t part1 = 0, part2 = 0;
+const size_t TIMERS = 9;
 
-    std::array<long long, 9> bins;
-    bins.fill(0);
+template <typename T>
+using matrix_t = std::array<std::array<T, TIMERS>, TIMERS>;
 
-    while (in.len > 0) {
-        size_t d = *in.s - '0';
-        in.s += 2;
-        in.len -= 2;
-        bins[d] += 1;
-    }
+template <typename T>
+using vector_t = std::array<T, TIMERS>;
 
-    for (size_t day = 1; day <= DAYS_PART2; day++) {
-        auto old = bins[0];
-        bins[0] = 0;
-        for (size_t i = 1; i < bins.size(); i++) {
-            bins[i - 1] += bins[i];  // move items one bin to the left
-            bins[i] = 0;
+template <typename T>
+static matrix_t<T> multiply(const matrix_t<T> &a, const matrix_t<T> &b) {
+    matrix_t<T> c{};
+    for (size_t i = 0; i < TIMERS; i++) {
+        for (size_t k = 0; k < TIMERS; k++) {
+            for (size_t j = 0; j < TIMERS; j++) c[i][j] += a[i][k] * b[k][j];
         }
-        bins[6] += old;
-        bins[8] += old;
+    }
+    return c;
+}
 
-        if (day == DAYS_PART1) {
-            part1 = std::accumulate(bins.cbegin(), bins.cend(), (uint64_t)0);
+// Number of fish after `days` days which a single fish with timer t turns
+// into, for every t. Row vector of ones times M^days, where M is the daily
+// transition (timer i + 1 -> i, 0 -> 6 and 8), in O(log days) matrix products.
+template <typename T>
+static vector_t<T> response(uint64_t days) {
+    matrix_t<T> m{};
+    for (size_t i = 1; i < TIMERS; i++) m[i][i - 1] = 1;
+    m[0][6] = 1;
+    m[0][8] = 1;
+
+    vector_t<T> r;
+    r.fill(1);
+    for (; days; days >>= 1) {
+        if (days & 1) {
+            // r = M^k r, all powers of M commute
+            vector_t<T> next{};
+            for (size_t i = 0; i < TIMERS; i++) {
+                for (size_t j = 0; j < TIMERS; j++) next[i] += m[i][j] * r[j];
+            }
+            r = next;
         }
+        m = multiply(m, m);
     }
+    return r;
+}
 
-    part2 = std::accumulate(bins.cbegin(), bins.cend(), (uint64_t)0);
+template <typename T>
+static T population(const vector_t<uint64_t> &bins, const vector_t<T> &response) {
+    T n = 0;
+    for (size_t i = 0; i < TIMERS; i++) n += T(bins[i]) * response[i];
+    return n;
+}
 
-    return {part1, part2};
+template <typename Input>
+static parse::output_t solve(Input &in) {
+    // independent of the input, so computed only once
+    static const auto response1 = response<uint64_t>(DAYS_PART1);
+    static const auto response2 = response<uint64_t>(DAYS_PART2);
+
+    vector_t<uint64_t> bins{};
+    while (parse::more(in)) {
+        size_t d = parse::peek(in) - '0';
+        parse::skip(in, 1);
+        if (parse::more(in)) parse::skip(in, 1);  // ',' or '\n'
+        bins[d] += 1;
+    }
+
+    return {population(bins, response1), population(bins, response2)};
 }
 
+parse::output_t day06(input_t in) { return solve(in); }
+
+parse::output_t day06_stream(parse::stream_t &in) { return solve(in); }
+
 #ifdef IS_MAIN
 int main() {
     input_t in = parse::load_input("input/day06.txt");
@@ -50,6 +90,7 @@ int main() {
 #ifdef IS_TEST
 
 #include <doctest/doctest.h>
+#include <testing.h>
 
 using std::make_tuple;
 
@@ -67,6 +108,10 @@ TEST_CASE("day06: examples") {
         auto output = day06(in);
         CHECK_EQ(std::get<1>(tc), output.answer[0]);
         CHECK_EQ(std::get<2>(tc), output.answer[1]);
+
+        auto streamed = solve_streamed(first, day06_stream, 8);
+        CHECK_EQ(std::get<1>(tc), streamed.answer[0]);
+        CHECK_EQ(std::get<2>(tc), streamed.answer[1]);
     }
 }
 
@@ -77,4 +122,37 @@ TEST_CASE("day06, part 1 & part 2") {
     CHECK_EQ("1653559299811", output.answer[1]);
 }
 
+TEST_CASE("day06: arbitrary number of days") {
+    // naive simulation of a single fish per timer, which is what response() computes
+    auto simulate = [](size_t days) {
+        std::array<vector_t<modular<1000000007>>, TIMERS> bins{};
+        for (size_t t = 0; t < TIMERS; t++) bins[t][t] = 1;
+        for (size_t day = 0; day < days; day++) {
+            for (auto &b : bins) {
+                auto old = b[0];
+                std::rotate(b.begin(), b.begin() + 1, b.end());
+                b[6] += old;
+            }
+        }
+        vector_t<modular<1000000007>> r;
+        for (size_t t = 0; t < TIMERS; t++) r[t] = std::accumulate(bins[t].begin(), bins[t].end(), modular<1000000007>(0));
+        return r;
+    };
+
+    for (size_t days : {0, 1, 7, 18, 80, 256, 1000, 4321}) CHECK(response<modular<1000000007>>(days) == simulate(days));
+
+    // 128-bit counts suffice for about 950 days
+    vector_t<uint64_t> bins{0, 1, 1, 2, 1};  // 3,4,3,1,2
+    CHECK_EQ("26984457539", to_string(population(bins, response<uint128_t>(256))));
+    CHECK_EQ(to_string(population(bins, response<uint128_t>(256))),
+             std::to_string(population(bins, response<uint64_t>(256))));
+    CHECK_EQ(population(bins, response<uint128_t>(800)) % 1000000007,
+             population(bins, response<modular<1000000007>>(800)).value);
+
+    // a billion days, instantly: one more day shifts every timer down by one
+    auto r = response<modular<1000000007>>(1000000000), next = response<modular<1000000007>>(1000000001);
+    CHECK(next[0] == r[6] + r[8]);
+    for (size_t t = 1; t < TIMERS; t++) CHECK(next[t] == r[t - 1]);
+}
+
 #endif  // IS_TEST
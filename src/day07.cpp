@@ -4,48 +4,63 @@ using parse::input_t;
 
 using num = int64_t;
 
-parse::output_t day07(input_t in) {
-    long part1 = 0, part2 = 0;
-
-    std::array<num, 1024> __numbers;
-    size_t numbers_count = 0;
+// Fuel needed to align all crabs at any position x, in O(1) per position after
+// O(n + range) setup: a counting sort over [lo, hi] turned into prefix sums of
+// crab counts and positions.
+struct alignment_t {
+    num lo, hi;
+    num n = 0, total = 0, squares = 0;
+    std::vector<num> count;  // count[i]: crabs at positions < lo + i
+    std::vector<num> sum;    // sum[i]: sum of their positions
+
+    alignment_t(std::span<const num> crabs) {
+        auto [min, max] = std::minmax_element(crabs.begin(), crabs.end());
+        lo = min == crabs.end() ? 0 : *min;
+        hi = max == crabs.end() ? 0 : *max;
+
+        count.assign(hi - lo + 2, 0);
+        for (auto x : crabs) count[x - lo + 1]++;
+
+        sum.assign(count.size(), 0);
+        for (size_t i = 1; i < count.size(); i++) {
+            sum[i] = sum[i - 1] + count[i] * (lo + static_cast<num>(i) - 1);
+            count[i] += count[i - 1];
+        }
 
-    num min = std::numeric_limits<num>().max();
-    num max = std::numeric_limits<num>().min();
+        n = count.back();
+        total = sum.back();
+        for (auto x : crabs) squares += x * x;
+    }
 
-    while (in.len > 0) {
-        num x = parse::positive<int>(in);
-        if (x < min) min = x;
-        if (x > max) max = x;
-        __numbers[numbers_count++] = x;
-        in.s++;
-        in.len--;
+    // sum of |x - crab|
+    num linear(num x) const {
+        size_t i = std::clamp(x - lo + 1, static_cast<num>(0), hi - lo + 1);
+        num left = count[i], left_sum = sum[i];  // crabs at positions <= x
+        return (x * left - left_sum) + (total - left_sum) - x * (n - left);
     }
 
-    std::span<num> numbers(__numbers.begin(), numbers_count);
-    std::sort(numbers.begin(), numbers.end());
-    num median = numbers[(numbers.size() + 1) / 2];
+    // sum of 1 + 2 + ... + |x - crab| = (d^2 + |d|) / 2
+    num triangular(num x) const { return (n * x * x - 2 * x * total + squares + linear(x)) / 2; }
 
-    for (auto x : numbers) {
-        part1 += x > median ? x - median : median - x;
+    // minimizes linear()
+    num median() const {
+        auto it = std::lower_bound(count.begin() + 1, count.end(), (n + 1) / 2);
+        return lo + (it - count.begin()) - 1;
     }
+};
 
-    long avg = std::accumulate(numbers.begin(), numbers.end(), (uint64_t)0) / numbers.size();
-
-    num min_fuel_part2 = std::numeric_limits<num>().max();
-    for (long delta = -1; delta <= 1; delta++) {
-        long pos = avg + delta;
-        if (pos < 0) continue;
-        num fuel_part2 = 0;
-        for (auto x : numbers) {
-            num delta = x > pos ? x - pos : pos - x;
-            // sum of numbers 1 .. n = n*(n+1)/2
-            fuel_part2 += (delta * (delta + 1)) / 2;
-        }
-        if (fuel_part2 < min_fuel_part2) min_fuel_part2 = fuel_part2;
-    }
+parse::output_t day07(input_t in) {
+    // every number takes at least two bytes, including its separator
+    std::vector<num> crabs(in.len / 2 + 1);
+    crabs.resize(parse::numbers<num>(in, crabs));
 
-    part2 = min_fuel_part2;
+    alignment_t alignment(crabs);
+
+    num part1 = alignment.linear(alignment.median());
+
+    // the triangular cost is convex, but evaluating every position is cheap
+    num part2 = std::numeric_limits<num>::max();
+    for (num x = alignment.lo; x <= alignment.hi; x++) part2 = std::min(part2, alignment.triangular(x));
 
     return {part1, part2};
 }
@@ -89,4 +104,22 @@ TEST_CASE("day07, part 1 & part 2") {
     CHECK_EQ("95581659", output.answer[1]);
 }
 
+TEST_CASE("day07: cost at every position") {
+    std::vector<num> crabs = {16, 1, 2, 0, 4, 2, 7, 1, 2, 14, -5, 30, 30};
+    alignment_t alignment(crabs);
+
+    num min_linear = std::numeric_limits<num>::max();
+    for (num x = -10; x <= 35; x++) {
+        num linear = 0, triangular = 0;
+        for (auto c : crabs) {
+            linear += std::abs(x - c);
+            triangular += std::abs(x - c) * (std::abs(x - c) + 1) / 2;
+        }
+        CHECK_EQ(linear, alignment.linear(x));
+        CHECK_EQ(triangular, alignment.triangular(x));
+        min_linear = std::min(min_linear, linear);
+    }
+    CHECK_EQ(min_linear, alignment.linear(alignment.median()));
+}
+
 #endif  // IS_TEST
@@ -2,7 +2,7 @@
 
 using parse::input_t;
 
-using digit = short;
+using mask_t = uint8_t;  // one bit per wire (a = bit 0) or segment
 
 /* Representation as a bitset:
  *                 0
@@ -33,204 +33,110 @@ using digit = short;
  *  gggg    gggg    ....    gggg    gggg
  *
  */
-constexpr digit ZERO = (1 << 0) | (1 << 1) | (1 << 2) | (1 << 4) | (1 << 5) | (1 << 6);
-constexpr digit ONE = (1 << 2) | (1 << 5);
-constexpr digit TWO = (1 << 0) | (1 << 2) | (1 << 3) | (1 << 4) | (1 << 6);
-constexpr digit THREE = (1 << 0) | (1 << 2) | (1 << 3) | (1 << 5) | (1 << 6);
-constexpr digit FOUR = (1 << 1) | (1 << 2) | (1 << 3) | (1 << 5);
-constexpr digit FIVE = (1 << 0) | (1 << 1) | (1 << 3) | (1 << 5) | (1 << 6);
-constexpr digit SIX = (1 << 0) | (1 << 1) | (1 << 3) | (1 << 4) | (1 << 5) | (1 << 6);
-constexpr digit SEVEN = (1 << 0) | (1 << 2) | (1 << 5);
-constexpr digit EIGHT = (1 << 0) | (1 << 1) | (1 << 2) | (1 << 3) | (1 << 4) | (1 << 5) | (1 << 6);
-constexpr digit NINE = (1 << 0) | (1 << 1) | (1 << 2) | (1 << 3) | (1 << 5) | (1 << 6);
-
-inline char l2pos(char c) {
-    assert(c >= 'a');
-    return c - 'a';
-}
-
-// Returns -1 on error.
-int8_t word2number(std::array<short, 7> &assignment, std::span<const char> word) {
-    digit d = 0;
-    for (auto c : word) {
-        size_t pos = assignment[l2pos(c)];
-        d |= 1 << pos;
-    }
-    switch (d) {
-        case ZERO:
-            return 0;
-        case ONE:
-            return 1;
-        case TWO:
-            return 2;
-        case THREE:
-            return 3;
-        case FOUR:
-            return 4;
-        case FIVE:
-            return 5;
-        case SIX:
-            return 6;
-        case SEVEN:
-            return 7;
-        case EIGHT:
-            return 8;
-        case NINE:
-            return 9;
-        default:
-            return -1;
+constexpr mask_t ZERO = (1 << 0) | (1 << 1) | (1 << 2) | (1 << 4) | (1 << 5) | (1 << 6);
+constexpr mask_t ONE = (1 << 2) | (1 << 5);
+constexpr mask_t TWO = (1 << 0) | (1 << 2) | (1 << 3) | (1 << 4) | (1 << 6);
+constexpr mask_t THREE = (1 << 0) | (1 << 2) | (1 << 3) | (1 << 5) | (1 << 6);
+constexpr mask_t FOUR = (1 << 1) | (1 << 2) | (1 << 3) | (1 << 5);
+constexpr mask_t FIVE = (1 << 0) | (1 << 1) | (1 << 3) | (1 << 5) | (1 << 6);
+constexpr mask_t SIX = (1 << 0) | (1 << 1) | (1 << 3) | (1 << 4) | (1 << 5) | (1 << 6);
+constexpr mask_t SEVEN = (1 << 0) | (1 << 2) | (1 << 5);
+constexpr mask_t EIGHT = (1 << 0) | (1 << 1) | (1 << 2) | (1 << 3) | (1 << 4) | (1 << 5) | (1 << 6);
+constexpr mask_t NINE = (1 << 0) | (1 << 1) | (1 << 2) | (1 << 3) | (1 << 5) | (1 << 6);
+
+// segment mask -> digit, -1 if it is not a digit (bit 7 marks a wire without a segment)
+constexpr std::array<int8_t, 256> DIGITS = [] {
+    std::array<int8_t, 256> table;
+    table.fill(-1);
+    const mask_t digits[] = {ZERO, ONE, TWO, THREE, FOUR, FIVE, SIX, SEVEN, EIGHT, NINE};
+    for (int8_t d = 0; d < 10; d++) table[digits[d]] = d;
+    return table;
+}();
+
+struct entry_t {
+    std::array<mask_t, 10> patterns;
+    std::array<mask_t, 4> output;
+};
+
+using wiring_t = std::array<uint8_t, 7>;  // wire -> segment
+
+static mask_t pattern(input_t &in) {
+    mask_t m = 0;
+    while (in.len > 0 && *in.s >= 'a' && *in.s <= 'g') {
+        m |= 1 << (*in.s - 'a');
+        in.s++, in.len--;
     }
+    // ' ', " | " or '\n'
+    while (in.len > 0 && (*in.s == ' ' || *in.s == '|' || *in.s == '\n')) in.s++, in.len--;
+    return m;
 }
 
-bool is_valid(std::array<short, 7> &assignment, std::vector<std::span<const char>> &words) {
-    for (auto &some_word : words) {
-        auto number = word2number(assignment, some_word);
-        if (number < 0) {
-            return false;
-        }
+/* Every segment but a/c and d/g is used by a different number of digits:
+ *   a: 8, b: 6, c: 8, d: 7, e: 4, f: 9, g: 7
+ * c is part of 1 but a is not, d is part of 4 but g is not.
+ */
+static wiring_t wiring(const std::array<mask_t, 10> &patterns) {
+    mask_t one = 0, four = 0;
+    std::array<uint8_t, 7> frequency{};
+    for (auto p : patterns) {
+        for (int w = 0; w < 7; w++) frequency[w] += (p >> w) & 1;
+        if (std::popcount(p) == 2) one = p;
+        if (std::popcount(p) == 4) four = p;
     }
-    return true;
-}
 
-bool solve(std::vector<std::span<const char>> &words, std::array<short, 7> &assignment) {
-    /* Numbers uniquely determined by its length:
-     *   1) 1 has two segments
-     *   2) 7 has three segments
-     *   3) 4 has four segments
-     *   4) 8 has seven segments
-     *
-     * Algorithm:
-     *
-     * 1) Find word for 1). Assign letters to slots 2,5.
-     * 2) Find word for 2). Knowning 1), this uniquely determines 0.
-     * 3) Find word for 3). Knowing 1), this determines 1,3.
-     * 4) The two remaining letters must be assigned to 4,6.
-     * 5) This leaves us with 64 combinations. Try each one and see if we can get a contradiction using ZERO, ..., EIGHT.
-     */
-    std::span<const char> two_letter, three_letter, four_letter;
-    for (auto &w : words) {
-        const size_t n = w.size();
-        switch (n) {
-            case 2:
-                two_letter = w;
+    wiring_t wiring;
+    for (int w = 0; w < 7; w++) {
+        switch (frequency[w]) {
+            case 4:
+                wiring[w] = 4;
                 break;
-            case 3:
-                three_letter = w;
+            case 6:
+                wiring[w] = 1;
                 break;
-            case 4:
-                four_letter = w;
+            case 7:
+                wiring[w] = (four >> w) & 1 ? 3 : 6;
                 break;
+            case 8:
+                wiring[w] = (one >> w) & 1 ? 2 : 0;
+                break;
+            case 9:
+                wiring[w] = 5;
+                break;
+            default:
+                wiring[w] = 7;  // never part of a digit
         }
     }
+    return wiring;
+}
 
-    // a is pos 0, b is pos 0 etc.; the values are the assigned segments.
-    std::array<std::unordered_set<short>, 7> candidates;
-    // Step 1
-    for (int i = 0; i < 2; i++) {
-        candidates[l2pos(two_letter[i])].insert(2);
-        candidates[l2pos(two_letter[i])].insert(5);
-    }
-
-    // Step 2
-    for (int i = 0; i < 3; i++) {
-        if (three_letter[i] != two_letter[0] && three_letter[i] != two_letter[1]) {
-            candidates[l2pos(three_letter[i])].insert(0);
-        }
-    }
-
-    // Step 3
-    for (int i = 0; i < 4; i++) {
-        if (four_letter[i] != two_letter[0] && four_letter[i] != two_letter[1]) {
-            candidates[l2pos(four_letter[i])].insert(1);
-            candidates[l2pos(four_letter[i])].insert(3);
-        }
-    }
-
-    for (size_t i = 0; i < candidates.size(); i++) {
-        if (candidates[i].empty()) {
-            candidates[i].insert(4);
-            candidates[i].insert(6);
-        }
-    }
-
-
-    bool found = false;
-    for (auto a_value : candidates[0]) {
-        assignment[0] = a_value;
-        for (auto b_value : candidates[1]) {
-            if (a_value == b_value) continue;
-            assignment[1] = b_value;
-            for (auto c_value : candidates[2]) {
-                if (a_value == c_value || b_value == c_value) continue;
-                assignment[2] = c_value;
-                for (auto d_value : candidates[3]) {
-                    if (a_value == d_value || b_value == d_value || c_value == d_value) continue;
-                    assignment[3] = d_value;
-                    for (auto e_value : candidates[4]) {
-                        if (a_value == e_value || b_value == e_value || c_value == e_value || d_value == e_value) continue;
-                        assignment[4] = e_value;
-                        for (auto f_value : candidates[5]) {
-                            if (a_value == f_value || b_value == f_value || c_value == f_value || d_value == f_value || e_value == f_value) continue;
-                            assignment[5] = f_value;
-                            for (auto g_value : candidates[6]) {
-                                if (a_value == g_value || b_value == g_value || c_value == g_value || d_value == g_value || e_value == g_value || f_value == g_value) continue;
-                                assignment[6] = g_value;
-                                if (is_valid(assignment, words)) {
-                                    found = true;
-                                    goto done;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        }
-    }
-
-done:
-    return found;
+// Returns -1 if the wires show no digit.
+static int8_t decode(const wiring_t &wiring, mask_t wires) {
+    mask_t segments = 0;
+    for (int w : bits(wires)) segments |= 1 << wiring[w];
+    return DIGITS[segments];
 }
 
 parse::output_t day08(input_t in) {
     uint64_t part1 = 0, part2 = 0;
 
-    std::vector<std::span<const char>> words;
-    words.reserve(10);
-
-    std::vector<short> rhs_digits;
-    rhs_digits.reserve(4);
-
-    std::array<short, 7> assignment;
-
-    bool rhs = false;
+    entry_t entry;
     while (in.len > 0) {
-        auto word = parse::word(in, 'a', 'z');
-        if (!rhs) {
-            words.push_back(word);
-        } else {
-            auto n = word.size();
-            if (n == 2 || n == 3 || n == 4 || n == 7) part1++;
-            int8_t number = word2number(assignment, word);
-            rhs_digits.push_back(number);
-        }
-        parse::skip_whitespace(in);
-        if (*in.s == '|') {
-            solve(words, assignment);
-            rhs = true;
-            in.s++;
-            in.len--;
-            parse::skip_whitespace(in);
-        } else if (*in.s == '\n') {
-            rhs = false;
-
-            uint64_t entry = rhs_digits[3] + 10 * rhs_digits[2] + 100 * rhs_digits[1] + 1000 * rhs_digits[0];
-            part2 += entry;
-
-            words.clear();
-            rhs_digits.clear();
-            in.s++;
-            in.len--;
+        for (auto &p : entry.patterns) p = pattern(in);
+        for (auto &p : entry.output) p = pattern(in);
+
+        auto wires = wiring(entry.patterns);
+        uint64_t value = 0;
+        for (auto p : entry.output) {
+            auto len = std::popcount(p);
+            if (len == 2 || len == 3 || len == 4 || len == 7) part1++;
+            const int8_t digit = decode(wires, p);
+            if (digit < 0) {
+                fmt::print(stderr, "day08: an output value shows no digit\n");
+                return {"-", "-"};
+            }
+            value = 10 * value + digit;
         }
+        part2 += value;
     }
 
     return {part1, part2};
@@ -284,30 +190,11 @@ TEST_CASE("day08, part 1 & part 2") {
     CHECK_EQ("986163", output.answer[1]);
 }
 
-TEST_CASE("solve") {
-    std::vector<std::span<const char>> words;
-
-    const char *a = "acedgfb";
-    const char *b = "cdfbe";
-    const char *c = "gcdfa";
-    const char *d = "fbcad";
-    const char *e = "dab";
-    const char *f = "cefabd";
-    const char *g = "cdfgeb";
-    const char *h = "eafb";
-    const char *i = "cagedb";
-    const char *j = "ab";
-
-    words.emplace_back(a, strlen(a));
-    words.emplace_back(b, strlen(b));
-    words.emplace_back(c, strlen(c));
-    words.emplace_back(d, strlen(d));
-    words.emplace_back(e, strlen(e));
-    words.emplace_back(f, strlen(f));
-    words.emplace_back(g, strlen(g));
-    words.emplace_back(h, strlen(h));
-    words.emplace_back(i, strlen(i));
-    words.emplace_back(j, strlen(j));
+TEST_CASE("day08: wiring") {
+    std::string line = "acedgfb cdfbe gcdfa fbcad dab cefabd cdfgeb eafb cagedb ab";
+    input_t in = {&line[0], static_cast<ssize_t>(line.length())};
+    std::array<mask_t, 10> patterns;
+    for (auto &p : patterns) p = pattern(in);
 
     /* Expected:
      *   dddd
@@ -318,22 +205,26 @@ TEST_CASE("solve") {
      *  g    b
      *   cccc
      */
-    // expected = {2, 5, 6, 0, 1, 3, 4}
-    std::array<short, 7> expected;
-    expected[l2pos('d')] = 0;
-    expected[l2pos('e')] = 1;
-    expected[l2pos('a')] = 2;
-    expected[l2pos('f')] = 3;
-    expected[l2pos('g')] = 4;
-    expected[l2pos('b')] = 5;
-    expected[l2pos('c')] = 6;
-    CHECK_EQ(true, is_valid(expected, words));
+    auto w = wiring(patterns);
+    CHECK_EQ(0, w['d' - 'a']);
+    CHECK_EQ(1, w['e' - 'a']);
+    CHECK_EQ(2, w['a' - 'a']);
+    CHECK_EQ(3, w['f' - 'a']);
+    CHECK_EQ(4, w['g' - 'a']);
+    CHECK_EQ(5, w['b' - 'a']);
+    CHECK_EQ(6, w['c' - 'a']);
+
+    const int8_t expected[] = {8, 5, 2, 3, 7, 9, 6, 4, 0, 1};
+    for (size_t i = 0; i < patterns.size(); i++) CHECK_EQ(expected[i], decode(w, patterns[i]));
+}
 
-    std::array<short, 7> assignment;
-    assignment.fill(-1);
-    bool found = solve(words, assignment);
-    CHECK_EQ(true, found);
-    CHECK_EQ(expected, assignment);
+TEST_CASE("day08: malformed output value") {
+    // "ac" lights two segments, but not the ones of a 1
+    std::string text = "acedgfb cdfbe gcdfa fbcad dab cefabd cdfgeb eafb cagedb ab | cdfeb fcadb ac cdbaf\n";
+    input_t in = {&text[0], static_cast<ssize_t>(text.length())};
+    auto output = day08(in);
+    CHECK_EQ("-", output.answer[0]);
+    CHECK_EQ("-", output.answer[1]);
 }
 
 #endif  // IS_TEST
@@ -1,83 +1,107 @@
 #include "day09.h"
-#include <utility>
 
 using parse::input_t;
 
-constexpr size_t MAX_COLS = 100;
-constexpr size_t MAX_ROWS = 100;
-
-// state
-static uint8_t heatmap[MAX_ROWS][MAX_COLS];
-static ssize_t rows;
-static ssize_t cols;
-
-inline bool is_lowpoint(ssize_t y, ssize_t x) {
-    auto val = heatmap[y][x];
-    if (x > 0 && heatmap[y][x - 1] <= val) return false;
-    if (x + 1 < cols && heatmap[y][x + 1] <= val) return false;
-    if (y + 1 < rows && heatmap[y + 1][x] <= val) return false;
-    if (y > 0 && heatmap[y - 1][x] <= val) return false;
-    return true;
+// Union-find over the runs of basin cells, with the number of cells per root.
+struct basins_t {
+    std::vector<uint32_t> parent;
+    std::vector<uint64_t> size;
+
+    uint32_t add(uint64_t cells) {
+        parent.push_back(parent.size());
+        size.push_back(cells);
+        return parent.size() - 1;
+    }
+
+    uint32_t find(uint32_t i) {
+        while (parent[i] != i) i = parent[i] = parent[parent[i]];
+        return i;
+    }
+
+    void merge(uint32_t a, uint32_t b) {
+        a = find(a), b = find(b);
+        if (a == b) return;
+        if (size[a] < size[b]) std::swap(a, b);
+        parent[b] = a;
+        size[a] += size[b];
+    }
+};
+
+// a horizontal run [begin, end) of basin cells
+struct run_t {
+    ssize_t begin, end;
+    uint32_t basin;
+};
+
+// Bit x is set iff row[x] is a 9, i.e. not part of any basin.
+static void walls(const char *row, ssize_t cols, std::vector<uint64_t> &mask) {
+    std::fill(mask.begin(), mask.end(), 0);
+    ssize_t x = 0;
+    for (; x + 32 <= cols; x += 32) mask[x / 64] |= static_cast<uint64_t>(parse::eq_mask32(row + x, '9')) << (x % 64);
+    for (; x < cols; x++) mask[x / 64] |= static_cast<uint64_t>(row[x] == '9') << (x % 64);
 }
 
-inline long risk_score(ssize_t i, ssize_t j) { return 1 + heatmap[i][j]; }
+// First x' >= x whose bit is `value`, or cols if there is none.
+static ssize_t next(const std::vector<uint64_t> &mask, ssize_t x, bool value, ssize_t cols) {
+    while (x < cols) {
+        uint64_t word = (value ? mask[x / 64] : ~mask[x / 64]) >> (x % 64);
+        if (word) return std::min(cols, x + std::countr_zero(word));
+        x = (x / 64 + 1) * 64;
+    }
+    return cols;
+}
 
 parse::output_t day09(input_t in) {
     long part1 = 0, part2 = 0;
 
-    while (in.len > 0) {
-        cols = 0;
-        while (in.len && *in.s != '\n') {
-            heatmap[rows][cols++] = parse::positive<uint8_t>(in, 1, false);
+    // the heights are read straight from the input, rows are cols + 1 apart
+    auto newline = static_cast<const char *>(memchr(in.s, '\n', in.len));
+    const ssize_t cols = newline ? newline - in.s : in.len;
+    const ssize_t stride = cols + 1;
+    const ssize_t rows = (in.len + 1) / stride;
+    auto height = [&](ssize_t y, ssize_t x) { return in.s[y * stride + x]; };
+
+    for (ssize_t y = 0; y < rows; y++) {
+        for (ssize_t x = 0; x < cols; x++) {
+            auto h = height(y, x);
+            if (x > 0 && height(y, x - 1) <= h) continue;
+            if (x + 1 < cols && height(y, x + 1) <= h) continue;
+            if (y > 0 && height(y - 1, x) <= h) continue;
+            if (y + 1 < rows && height(y + 1, x) <= h) continue;
+            part1 += 1 + h - '0';
         }
-        rows++;
-        in.s++;
-        in.len--;
     }
 
-    std::unordered_set<iPair, std::hash<iPair>> visited;
-    std::vector<int> basin_sizes;
-    basin_sizes.reserve(100);
-
-    for (short y = 0; y < rows; y++) {
-        for (short x = 0; x < cols; x++) {
-            if (is_lowpoint(y, x)) {
-                part1 += risk_score(y, x);
-
-                // part 2: bfs
-                std::queue<iPair> queue;
-                queue.emplace(x, y);
-                visited.emplace(x, y);
-                int current_basin_size = 1;
-                uint8_t lowest = heatmap[y][x];
-                while (!queue.empty()) {
-                    auto current = queue.front();
-                    queue.pop();
-                    // check neighbors
-                    std::vector<iPair> neighbors;
-                    neighbors.reserve(4);
-                    if (current.x > 0) neighbors.emplace_back(current.x - 1, current.y);
-                    if (current.x + 1 < cols) neighbors.emplace_back(current.x + 1, current.y);
-                    if (current.y + 1 < rows) neighbors.emplace_back(current.x, current.y + 1);
-                    if (current.y > 0) neighbors.emplace_back(current.x, current.y - 1);
-
-                    for (auto nb : neighbors) {
-                        if (heatmap[nb.y][nb.x] != 9 && heatmap[nb.y][nb.x] > lowest) {
-                            if (!visited.contains(nb)) {
-                                queue.push(nb);
-                                visited.insert(nb);
-                                current_basin_size++;
-                            }
-                        }
-                    }
-                }
-                basin_sizes.push_back(current_basin_size);
-            }
+    // part 2: every basin is a connected component of cells below 9, so label
+    // the runs of such cells row by row and merge runs which touch the previous row
+    basins_t basins;
+    std::vector<uint64_t> mask((cols + 63) / 64);
+    std::vector<run_t> previous, current;
+    for (ssize_t y = 0; y < rows; y++) {
+        walls(in.s + y * stride, cols, mask);
+        current.clear();
+
+        size_t j = 0;
+        for (ssize_t x = next(mask, 0, false, cols); x < cols;) {
+            ssize_t end = next(mask, x, true, cols);
+            auto basin = basins.add(end - x);
+
+            while (j < previous.size() && previous[j].end <= x) j++;
+            for (size_t k = j; k < previous.size() && previous[k].begin < end; k++) basins.merge(basin, previous[k].basin);
+
+            current.push_back({x, end, basin});
+            x = next(mask, end, false, cols);
         }
+        std::swap(previous, current);
     }
-    std::sort(basin_sizes.begin(), basin_sizes.end(), [](auto x, auto y) -> bool { return x > y; });
 
-    part2 = (long)basin_sizes[0] * (long)basin_sizes[1] * (long)basin_sizes[2];
+    std::vector<uint64_t> sizes;
+    for (uint32_t i = 0; i < basins.parent.size(); i++) {
+        if (basins.parent[i] == i) sizes.push_back(basins.size[i]);
+    }
+    std::partial_sort(sizes.begin(), sizes.begin() + std::min<size_t>(3, sizes.size()), sizes.end(), std::greater<>());
+
+    if (sizes.size() >= 3) part2 = sizes[0] * sizes[1] * sizes[2];
 
     return {part1, part2};
 }
@@ -97,12 +121,6 @@ int main() {
 
 using std::make_tuple;
 
-void reset_state() {
-    memset(heatmap, 0, MAX_ROWS * MAX_COLS);
-    rows = 0;
-    cols = 0;
-}
-
 TEST_CASE("day09: examples") {
     auto test_cases = {
         make_tuple("2199943210\n"
@@ -114,8 +132,6 @@ TEST_CASE("day09: examples") {
     };
 
     for (auto& tc : test_cases) {
-        reset_state();
-
         auto first = std::string(std::get<0>(tc));
         input_t in = {&first[0], static_cast<ssize_t>(first.length())};
 
@@ -127,11 +143,23 @@ TEST_CASE("day09: examples") {
 
 TEST_CASE("day09, part 1 & part 2") {
     input_t in = parse::load_input("input/day09.txt");
-    reset_state();
     auto output = day09(in);
 
     CHECK_EQ("600", output.answer[0]);
     CHECK_EQ("987840", output.answer[1]);
 }
 
+TEST_CASE("day09: large heightmap") {
+    // 9s on a lattice split the map into 3x3 basins, one of which is joined with its right neighbor
+    const ssize_t n = 1000;
+    std::string map;
+    for (ssize_t y = 0; y < n; y++) {
+        for (ssize_t x = 0; x < n; x++) map += (x % 4 == 3 || y % 4 == 3) && !(y == 1 && x == 3) ? '9' : static_cast<char>('0' + (x % 4 + y % 4) % 3);
+        map += '\n';
+    }
+    input_t in = {&map[0], static_cast<ssize_t>(map.length())};
+    auto output = day09(in);
+    CHECK_EQ("1539", output.answer[1]);  // 19 * 9 * 9
+}
+
 #endif  // IS_TEST
@@ -2,112 +2,107 @@
 
 using parse::input_t;
 
-inline char close_bracket(char bracket) {
-    switch (bracket) {
-        case '(':
-            return ')';
-        case '[':
-            return ']';
-        case '{':
-            return '}';
-        case '<':
-            return '>';
-        default:
-            abort();
-    };
+// Classification of every byte: brackets get their kind (0-3 for (, [, { and <)
+// and whether they open or close a chunk, anything else is 0.
+constexpr uint8_t OPEN = 0x10;
+constexpr uint8_t CLOSE = 0x20;
+constexpr std::array<uint8_t, 256> CLASS = [] {
+    std::array<uint8_t, 256> table{};
+    const char open[] = "([{<", close[] = ")]}>";
+    for (uint8_t kind = 0; kind < 4; kind++) {
+        table[static_cast<uint8_t>(open[kind])] = OPEN | kind;
+        table[static_cast<uint8_t>(close[kind])] = CLOSE | kind;
+    }
+    return table;
+}();
+
+// by kind of the illegal closing bracket, the completion score of a kind is kind + 1
+constexpr int64_t ERROR_SCORE[] = {3, 57, 1197, 25137};
+
+constexpr size_t MAX_DEPTH = 1024;
+
+// Adds the line's error score to `errors`, or its completion score to `completions`.
+static void check(std::span<const char> line, int64_t &errors, std::vector<int64_t> &completions) {
+    // stack[1 .. depth] are the open chunks, stack[0] never matches a kind.
+    // Lines nested deeper than MAX_DEPTH move it to the heap, no deeper than the line is long.
+    std::array<uint8_t, MAX_DEPTH + 2> fixed;
+    std::vector<uint8_t> spilled;
+    uint8_t *stack = fixed.data();
+    stack[0] = 0xff;
+    size_t depth = 0;
+
+    for (auto c : line) {
+        const uint8_t k = CLASS[static_cast<uint8_t>(c)];
+        if (!k) continue;
+        const uint8_t kind = k & 3;
+        const bool open = k & OPEN;
+
+        // push unconditionally, only an opening bracket keeps it
+        stack[depth + 1] = kind;
+        const bool illegal = !open && stack[depth] != kind;
+        depth = depth + 2 * open - 1;
+
+        if (illegal) {
+            errors += ERROR_SCORE[kind];
+            return;
+        }
+        if (depth > MAX_DEPTH && stack == fixed.data()) {
+            spilled.resize(line.size() + 2);
+            std::copy(fixed.begin(), fixed.begin() + depth + 1, spilled.begin());
+            stack = spilled.data();
+        }
+    }
+
+    int64_t score = 0;
+    for (; depth > 0; depth--) score = 5 * score + stack[depth] + 1;
+    completions.push_back(score);
 }
 
-inline int64_t compute_score(char bracket) {
-    switch (bracket) {
-        case ')':
-            return 3;
-        case ']':
-            return 57;
-        case '}':
-            return 1197;
-        case '>':
-            return 25137;
-        default:
-            abort();
+// Finds the newlines 32 bytes at a time.
+template <typename F>
+static void for_each_line(input_t &in, F f) {
+    ssize_t begin = 0, i = 0;
+    for (; i + 32 <= in.len; i += 32) {
+        for (int b : bits(parse::eq_mask32(in.s + i, '\n'))) {
+            f(std::span<const char>(in.s + begin, in.s + i + b));
+            begin = i + b + 1;
+        }
+    }
+    for (; i < in.len; i++) {
+        if (in.s[i] == '\n') {
+            f(std::span<const char>(in.s + begin, in.s + i));
+            begin = i + 1;
+        }
     }
+    if (begin < in.len) f(std::span<const char>(in.s + begin, in.s + in.len));
 }
 
-inline int64_t compute_completion_score(char bracket) {
-    switch (bracket) {
-        case ')':
-            return 1;
-        case ']':
-            return 2;
-        case '}':
-            return 3;
-        case '>':
-            return 4;
-        default:
-            abort();
-    }
+template <typename F>
+static void for_each_line(parse::stream_t &in, F f) {
+    while (parse::more(in)) f(parse::line(in));
 }
 
-parse::output_t day10(input_t in) {
+template <typename Input>
+static parse::output_t solve(Input &in) {
     int64_t part1 = 0, part2 = 0;
 
-    std::vector<int64_t> all_completion_scores;
-    all_completion_scores.reserve(100);
-
-    while (in.len > 0) {
-        ssize_t pos_eol = 0;
-        while (pos_eol < in.len && in.s[pos_eol] != '\n') pos_eol++;
-        std::span<const char> word = std::span(in.s, pos_eol);
-        pos_eol++;
-        in.s += pos_eol;
-        in.len -= pos_eol;
-
-        std::stack<char> open_chunks;
-
-        int64_t completion_score = 0;
-
-        for (auto c : word) {
-            switch (c) {
-                case '(':
-                case '[':
-                case '{':
-                case '<':
-                    open_chunks.push(c);
-                    break;
-                case ')':
-                case ']':
-                case '}':
-                case '>':
-                    const char last_open = open_chunks.top();
-                    open_chunks.pop();
-                    const char expected = close_bracket(last_open);
-                    if (expected != c) {
-                        part1 += compute_score(c);
-                        goto found_error;
-                    }
-                    break;
-            }
-        }
-
-        // at this point, the word is incomplete
-
-        while (!open_chunks.empty()) {
-            auto missing_bracket = close_bracket(open_chunks.top());
-            open_chunks.pop();
-            completion_score *= 5;
-            completion_score += compute_completion_score(missing_bracket);
-        }
-        all_completion_scores.push_back(completion_score);
+    std::vector<int64_t> completions;
+    for_each_line(in, [&](std::span<const char> line) { check(line, part1, completions); });
 
-    found_error:;
+    if (!completions.empty()) {
+        assert(completions.size() % 2 == 1);
+        auto median = completions.begin() + completions.size() / 2;
+        std::nth_element(completions.begin(), median, completions.end());
+        part2 = *median;
     }
 
-    std::sort(all_completion_scores.begin(), all_completion_scores.end());
-    assert(all_completion_scores.size() % 2 == 1);
-    part2 = all_completion_scores[all_completion_scores.size() / 2];
-
     return {part1, part2};
 }
 
+parse::output_t day10(input_t in) { return solve(in); }
+
+parse::output_t day10_stream(parse::stream_t &in) { return solve(in); }
+
 #ifdef IS_MAIN
 int main() {
     input_t in = parse::load_input("input/day10.txt");
@@ -120,6 +115,7 @@ int main() {
 #ifdef IS_TEST
 
 #include <doctest/doctest.h>
+#include <testing.h>
 
 using std::make_tuple;
 
@@ -146,6 +142,10 @@ TEST_CASE("day10: examples") {
         auto output = day10(in);
         CHECK_EQ(std::get<1>(tc), output.answer[0]);
         CHECK_EQ(std::get<2>(tc), output.answer[1]);
+
+        auto streamed = solve_streamed(first, day10_stream, 8);
+        CHECK_EQ(std::get<1>(tc), streamed.answer[0]);
+        CHECK_EQ(std::get<2>(tc), streamed.answer[1]);
     }
 }
 
@@ -156,4 +156,19 @@ TEST_CASE("day10, part 1 & part 2") {
     CHECK_EQ("4245130838", output.answer[1]);
 }
 
+TEST_CASE("day10: deeply nested lines") {
+    // 5000 open chunks: closed by 4999 matching brackets and a corrupted one,
+    // or by all but the outermost 20
+    std::string open, close;
+    for (int i = 0; i < 5000; i++) open += "([{<"[i % 4], close += ")]}>"[(4999 - i) % 4];
+    std::string text = open + close.substr(0, 4999) + "]\n" + open + close.substr(0, 4980) + "\n";
+    input_t in = {&text[0], static_cast<ssize_t>(text.length())};
+    auto output = day10(in);
+    CHECK_EQ("57", output.answer[0]);
+
+    int64_t score = 0;
+    for (int i = 19; i >= 0; i--) score = 5 * score + i % 4 + 1;
+    CHECK_EQ(std::to_string(score), output.answer[1]);
+}
+
 #endif  // IS_TEST
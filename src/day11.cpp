@@ -2,85 +2,99 @@
 
 using parse::input_t;
 
-constexpr size_t WIDTH = 10;
-constexpr size_t HEIGHT = 10;
+// Octopus grid of any size. The energy levels are padded with one cell on
+// every side, so that flashes need no bounds checks. Padding cells receive at
+// most 1 + 3 energy per step and are cleared after every step, so they never
+// flash.
+struct octopuses_t {
+    ssize_t width, height, stride;
+    std::vector<uint8_t> energy;
+    std::vector<uint32_t> frontier;  // cells which flashed in the current step
+    uint64_t steps = 0;
+    uint64_t synchronized = 0;  // first step in which all octopuses flashed, 0 if none yet
+
+    octopuses_t(ssize_t width, ssize_t height)
+        : width(width), height(height), stride(width + 2), energy((height + 2) * stride), frontier(width * height) {}
+
+    uint8_t &at(ssize_t y, ssize_t x) { return energy[(y + 1) * stride + x + 1]; }
+
+    // Advances one step and returns the number of flashes.
+    uint64_t step() {
+        steps++;
+        const uint64_t n = width * height;
+        // after all flashed together they stay in sync, flashing every 10 steps
+        if (synchronized) return (steps - synchronized) % 10 == 0 ? n : 0;
+
+        // every level increases by 1, those above 9 flash
+        size_t flashes = 0;
+        size_t i = 0;
+        const __m128i one = _mm_set1_epi8(1), nine = _mm_set1_epi8(9);
+        for (; i + 16 <= energy.size(); i += 16) {
+            auto p = reinterpret_cast<__m128i *>(&energy[i]);
+            __m128i v = _mm_add_epi8(_mm_loadu_si128(p), one);
+            _mm_storeu_si128(p, v);
+            for (int b : bits(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(v, nine))))) frontier[flashes++] = i + b;
+        }
+        for (; i < energy.size(); i++) {
+            if (++energy[i] > 9) frontier[flashes++] = i;
+        }
 
-using num = int8_t;
+        // flashes increase the neighbors' levels, which may flash in turn
+        const ssize_t offsets[] = {-stride - 1, -stride, -stride + 1, -1, 1, stride - 1, stride, stride + 1};
+        for (size_t next = 0; next < flashes; next++) {
+            const ssize_t c = frontier[next];
+            for (auto o : offsets) {
+                if (++energy[c + o] == 10) frontier[flashes++] = c + o;
+            }
+        }
 
-parse::output_t day11(input_t in) {
-    uint64_t part1 = 0, part2 = std::numeric_limits<uint64_t>().max();
+        for (size_t f = 0; f < flashes; f++) energy[frontier[f]] = 0;
+        clear_padding();
 
-    num board[HEIGHT][WIDTH];
+        if (flashes == n) synchronized = steps;
+        return flashes;
+    }
 
-    size_t y = 0;
-    while (in.len > 0) {
-        size_t x = 0;
-        while (in.len > 0 && *in.s != '\n') {
-            board[y][x++] = parse::positive<num>(in, 1, false);
+    // Advances `count` steps and returns the number of flashes, in O(1) once synchronized.
+    uint64_t run(uint64_t count) {
+        uint64_t flashes = 0;
+        for (; count > 0 && !synchronized; count--) flashes += step();
+        if (count > 0) {
+            // flashes at the steps synchronized + 10k in (steps, steps + count]
+            auto flashed_by = [&](uint64_t s) { return (s - synchronized) / 10; };
+            flashes += (flashed_by(steps + count) - flashed_by(steps)) * width * height;
+            steps += count;
         }
-        in.s++;
-        in.len--;
-        x = 0;
-        y++;
+        return flashes;
     }
 
-    auto get_neighbors = [&](uint8_t y, uint8_t x) -> std::vector<std::pair<uint8_t, uint8_t>> {
-        std::vector<std::pair<uint8_t, uint8_t>> neighbors;
-        neighbors.reserve(8);
-        if (x > 0) neighbors.emplace_back(y, x - 1);
-        if (x > 0 && y > 0) neighbors.emplace_back(y - 1, x - 1);
-        if (y > 0) neighbors.emplace_back(y - 1, x);
-        if (y > 0 && x < WIDTH - 1) neighbors.emplace_back(y - 1, x + 1);
-        if (x < WIDTH - 1) neighbors.emplace_back(y, x + 1);
-        if (y < HEIGHT - 1 && x < WIDTH - 1) neighbors.emplace_back(y + 1, x + 1);
-        if (y < HEIGHT - 1) neighbors.emplace_back(y + 1, x);
-        if (y < HEIGHT - 1 && x > 0) neighbors.emplace_back(y + 1, x - 1);
-        return neighbors;
-    };
-
-    std::queue<std::pair<uint8_t, uint8_t>> flashes;
-    for (size_t step = 1; step < std::numeric_limits<size_t>().max(); step++) {
-        for (uint8_t y = 0; y < HEIGHT; y++) {
-            for (size_t x = 0; x < WIDTH; x++) {
-                // First, the energy level of each octopus increases by `1`
-                board[y][x]++;
-                // Then, any octopus with an energy level greater than `9` *flashes*
-                if (board[y][x] == 10) {
-                    flashes.push(std::make_pair(y, x));
-                }
-            }
-        }
-        while (!flashes.empty()) {
-            auto current = flashes.front();
-            auto neighbors = get_neighbors(current.first, current.second);
-            for (auto p : neighbors) {
-                board[p.first][p.second]++;
-                if (board[p.first][p.second] == 10) {
-                    flashes.push(p);
-                }
-            }
-            flashes.pop();
-        }
+   private:
+    void clear_padding() {
+        std::fill_n(energy.begin(), stride, 0);
+        std::fill_n(energy.end() - stride, stride, 0);
+        for (ssize_t y = 1; y <= height; y++) energy[y * stride] = energy[y * stride + width + 1] = 0;
+    }
+};
 
-        // Finally, any octopus that flashed during this step has its energy level set to `0`
-        size_t counter = 0;
-        for (uint8_t y = 0; y < HEIGHT; y++) {
-            for (size_t x = 0; x < WIDTH; x++) {
-                if (board[y][x] > 9) {
-                    board[y][x] = 0;
-                    if (step <= 100) part1++;
-                }
-                if (board[y][x] == 0) counter++;
-            }
-        }
-        if (counter == WIDTH * HEIGHT) {
-            part2 = std::min(step, part2);
-            if (step >= 100) goto done;
-        }
+static octopuses_t parse_octopuses(input_t &in) {
+    auto newline = static_cast<const char *>(memchr(in.s, '\n', in.len));
+    const ssize_t width = newline ? newline - in.s : in.len;
+    const ssize_t height = (in.len + 1) / (width + 1);
 
+    octopuses_t octopuses(width, height);
+    for (ssize_t y = 0; y < height; y++) {
+        for (ssize_t x = 0; x < width; x++) octopuses.at(y, x) = in.s[y * (width + 1) + x] - '0';
     }
-done:
+    return octopuses;
+}
+
+parse::output_t day11(input_t in) {
+    uint64_t part1 = 0, part2 = 0;
 
+    auto octopuses = parse_octopuses(in);
+    part1 = octopuses.run(100);
+    while (!octopuses.synchronized) octopuses.step();
+    part2 = octopuses.synchronized;
 
     return {part1, part2};
 }
@@ -133,4 +147,52 @@ TEST_CASE("day11, part 1 & part 2") {
     CHECK_EQ("258", output.answer[1]);
 }
 
+TEST_CASE("day11: any size") {
+    // straightforward simulation of a 37x23 grid
+    const ssize_t width = 37, height = 23;
+    std::string text;
+    std::vector<std::vector<int>> grid(height, std::vector<int>(width));
+    for (ssize_t y = 0; y < height; y++) {
+        for (ssize_t x = 0; x < width; x++) {
+            grid[y][x] = (x * 7 + y * 3 + x * y) % 10;
+            text += static_cast<char>('0' + grid[y][x]);
+        }
+        text += '\n';
+    }
+    input_t in = {&text[0], static_cast<ssize_t>(text.length())};
+    auto octopuses = parse_octopuses(in);
+
+    for (int step = 0; step < 1000; step++) {
+        std::vector<std::pair<ssize_t, ssize_t>> flashes;
+        for (ssize_t y = 0; y < height; y++) {
+            for (ssize_t x = 0; x < width; x++) {
+                if (++grid[y][x] == 10) flashes.emplace_back(y, x);
+            }
+        }
+        for (size_t i = 0; i < flashes.size(); i++) {
+            auto [y, x] = flashes[i];
+            for (ssize_t ny = std::max<ssize_t>(y - 1, 0); ny <= std::min(y + 1, height - 1); ny++) {
+                for (ssize_t nx = std::max<ssize_t>(x - 1, 0); nx <= std::min(x + 1, width - 1); nx++) {
+                    if (++grid[ny][nx] == 10) flashes.emplace_back(ny, nx);
+                }
+            }
+        }
+        for (auto [y, x] : flashes) grid[y][x] = 0;
+
+        CHECK_EQ(flashes.size(), octopuses.step());
+    }
+
+    // once in sync, run() skips ahead
+    input_t puzzle = parse::load_input("input/day11.txt");
+    auto synced = parse_octopuses(puzzle);
+    synced.run(300);
+    CHECK_EQ(258u, synced.synchronized);
+
+    uint64_t stepped = 0;
+    auto copy = synced;
+    for (int step = 0; step < 1234; step++) stepped += copy.step();
+    CHECK_EQ(stepped, synced.run(1234));
+    CHECK_EQ(copy.steps, synced.steps);
+}
+
 #endif  // IS_TEST
@@ -1,190 +1,131 @@
 #include "day12.h"
 
 #include <cstdint>
+#include <optional>
 #include <graph.h>
-#include <unordered_set>
 
-using graph::Graph;
 using parse::input_t;
-using node_t = uint8_t;
+using node_t = uint32_t;
 
 namespace Day12 {
 
-using MyGraph = graph::Graph<100, 50, uint8_t>;
-
-struct BT {
-    std::unordered_map<node_t, std::string> id2label;
-    std::unordered_map<std::string, node_t> label2id;
-    MyGraph *graph;
-    uint32_t part1, part2;
-    uint8_t start, end;
-};
-
-typedef BT *data; /* type to pass data to backtrack */
-
-#define MAXCANDIDATES 100 /* max possible next extensions */
-#define NMAX 100          /* maximum solution size */
-
-static bool finished = false; /* found all solutions yet? */
-
-static bool is_a_solution(int a[], int k, data ctx) {
-    return a[k] == ctx->end && a[0] == ctx->start;
-}
-
-static void process_solution(int a[], int k, data ctx) {
-    std::unordered_map<int, uint32_t> small_count;
-    for (int i = 0; i <= k; i++) {
-        std::string label = ctx->id2label[a[i]];
-        if (label[0] >= 'a' && label[0] <= 'z') {
-            small_count[a[i]]++;
+using MyGraph = graph::csr_t<>;
+
+// Visited small caves are a bitmask, so there may be at most 64 of them.
+constexpr size_t MAX_SMALL = 64;
+
+/* Number of paths between small caves, with big caves contracted away:
+ * a path a - B - b through big cave B is an edge a - b like a direct one
+ * (a == b is possible, which is a revisit of a). Big caves are never adjacent,
+ * otherwise there would be infinitely many paths.
+ */
+struct caves_t {
+    size_t start, end;
+    std::vector<std::vector<std::pair<size_t, uint64_t>>> edges;  // (small cave, multiplicity)
+
+    // memo[2 * cave + twice][visited] = paths from `cave` to end
+    std::vector<std::unordered_map<uint64_t, uint64_t>> memo;
+
+    // `twice`: a small cave was already visited twice, or that is not allowed
+    uint64_t paths(size_t cave, uint64_t visited, bool twice) {
+        if (cave == end) return 1;
+
+        auto &m = memo[2 * cave + twice];
+        if (auto it = m.find(visited); it != m.end()) return it->second;
+
+        uint64_t count = 0;
+        for (auto [next, multiplicity] : edges[cave]) {
+            if (next == start) continue;
+            const uint64_t bit = uint64_t(1) << next;
+            if (!(visited & bit)) {
+                count += multiplicity * paths(next, visited | bit, twice);
+            } else if (!twice) {
+                count += multiplicity * paths(next, visited, true);
+            }
         }
+        return m[visited] = count;
     }
+};
 
-    size_t duplicates = 0;
-    for (auto kv : small_count) {
-        if (kv.second > 1)
-            duplicates++;
-    }
-    if (duplicates == 0)
-        ctx->part1++;
-    if (duplicates <= 1)
-        ctx->part2++;
-}
-
-/*	What are possible elements for position k? */
-static void construct_candidates(int a[], int k, data ctx, int c[],
-                                 int *ncandidates) {
-    assert(k > 0);
-    std::unordered_map<int, uint32_t> small_count;
-    small_count.reserve(k);
-    for (int i = 0; i < k; i++) {
-        std::string label = ctx->id2label[a[i]];
-        // is lowercase?
-        if (label[0] >= 'a' && label[0] <= 'z')
-            small_count[a[i]]++;
-    }
-    size_t duplicates = 0;
-    for (auto kv : small_count) {
-        if (kv.second > 1)
-            duplicates += kv.second;
-    }
-    if (duplicates > 2) {
-        *ncandidates = 0;
-        return;  // no candidates
-    }
-
-    int count = 0;
-    for (auto x : ctx->graph->edges(a[k - 1])) {
-        if (x != ctx->start)
-            c[count++] = x;
+// No caves if two big caves are adjacent.
+static std::optional<caves_t> contract(const MyGraph &g, const std::vector<int> &small, node_t start, node_t end) {
+    const size_t n = std::count_if(small.begin(), small.end(), [](int s) { return s >= 0; });
+
+    std::vector<std::vector<uint64_t>> multiplicity(n, std::vector<uint64_t>(n));
+    for (node_t a = 0; a < g.nvertices(); a++) {
+        if (small[a] < 0) continue;
+        for (auto b : g.edges(a)) {
+            if (small[b] >= 0) {
+                multiplicity[small[a]][small[b]]++;
+                continue;
+            }
+            for (auto c : g.edges(b)) {
+                if (small[c] < 0) return std::nullopt;
+                multiplicity[small[a]][small[c]]++;
+            }
+        }
     }
-    *ncandidates = count;
-}
-
-/*
-Copyright 2003 by Steven S. Skiena; all rights reserved.
-
-Permission is granted for use in non-commerical applications
-provided this copyright notice remains intact and unchanged.
-
-This program appears in my book:
-
-"Programming Challenges: The Programming Contest Training Manual"
-by Steven Skiena and Miguel Revilla, Springer-Verlag, New York 2003.
-
-See our website www.programming-challenges.com for additional information.
-
-This book can be ordered from Amazon.com at
-
-http://www.amazon.com/exec/obidos/ASIN/0387001638/thealgorithmrepo/
 
-*/
-static void backtrack(int a[], int k, data input) {
-    int c[MAXCANDIDATES]; /* candidates for next position */
-    int ncandidates;      /* next position candidate count */
-    int i;                /* counter */
-
-    if (is_a_solution(a, k, input)) {
-        process_solution(a, k, input);
-    } else {
-        k = k + 1;
-        construct_candidates(a, k, input, c, &ncandidates);
-        for (i = 0; i < ncandidates; i++) {
-            a[k] = c[i];
-            backtrack(a, k, input);
-            if (finished)
-                return; /* terminate early */
+    caves_t caves;
+    caves.start = small[start];
+    caves.end = small[end];
+    caves.edges.resize(n);
+    caves.memo.resize(2 * n);
+    for (size_t a = 0; a < n; a++) {
+        for (size_t b = 0; b < n; b++) {
+            if (multiplicity[a][b]) caves.edges[a].emplace_back(b, multiplicity[a][b]);
         }
     }
+    return caves;
 }
 
 }  // namespace Day12
 
 parse::output_t day12(input_t in) {
-    Day12::MyGraph g;
-    Day12::BT bt;
-    bt.graph = &g;
-    bt.id2label.reserve(32);
-    bt.label2id.reserve(32);
-
-    node_t id_counter = 1;
-    auto parse_word = [](input_t &in) -> std::string {
+    graph::builder_t builder;
+
+    // small[id] is the bit of a small cave or -1
+    std::unordered_map<std::string_view, node_t> label2id;
+    std::vector<int> small;
+    int small_count = 0;
+
+    auto parse_node = [&](input_t &in) -> node_t {
         const char *first = in.s;
-        size_t count = 0;
+        while (in.len > 0 && ((*in.s >= 'a' && *in.s <= 'z') || (*in.s >= 'A' && *in.s <= 'Z'))) in.s++, in.len--;
+        std::string_view label(first, in.s - first);
 
-        while (in.len > 0 &&
-               ((*in.s >= 'a' && *in.s <= 'z') || (*in.s >= 'A' && *in.s <= 'Z'))) {
-            in.s++, in.len--;
-            count++;
+        auto [it, inserted] = label2id.emplace(label, small.size());
+        if (inserted) {
+            const bool is_small = label[0] >= 'a' && label[0] <= 'z';
+            small.push_back(is_small ? small_count++ : -1);
         }
-        return std::string(first, count);
+        return it->second;
     };
-    while (in.len > 0) {
-        auto from = parse_word(in);
-
-        node_t from_id;
-        if (!bt.label2id.contains(from)) {
-            from_id = id_counter;
-            bt.label2id[from] = from_id;
-            bt.id2label[from_id] = from;
-            id_counter++;
-        } else {
-            from_id = bt.label2id[from];
-        }
-
-        in.s++;
-        in.len--;
-        auto to = parse_word(in);
-
-        node_t to_id;
-        if (!bt.label2id.contains(to)) {
-            to_id = id_counter;
-            bt.label2id[to] = to_id;
-            bt.id2label[to_id] = to;
-            id_counter++;
-        } else {
-            to_id = bt.label2id[to];
-        }
-
-        g.insert_edge(from_id, to_id, false);
 
-        in.s++;
-        in.len--;
+    while (in.len > 0) {
+        auto from = parse_node(in);
+        in.s++, in.len--;  // '-'
+        auto to = parse_node(in);
+        in.s++, in.len--;  // '\n'
+        builder.add_edge(from, to, {}, false);
     }
 
-    node_t start_id = bt.label2id["start"];
-    node_t end_id = bt.label2id["end"];
-
-    bt.start = start_id;
-    bt.end = end_id;
-    bt.part1 = 0;
-    bt.part2 = 0;
-
-    int a[MAXCANDIDATES];
-    a[0] = start_id;
-    backtrack(a, 0, &bt);
-
-    return {bt.part1, bt.part2};
+    auto error = [](const char *message) -> parse::output_t {
+        fmt::print(stderr, "day12: {}\n", message);
+        return {"-", "-"};
+    };
+    if (small_count > static_cast<int>(Day12::MAX_SMALL)) return error("too many small caves");
+    auto start = label2id.find("start"), end = label2id.find("end");
+    if (start == label2id.end() || end == label2id.end()) return error("no start or end");
+
+    auto contracted = Day12::contract(builder.build(), small, start->second, end->second);
+    if (!contracted) return error("two big caves are adjacent, there are infinitely many paths");
+    auto &caves = *contracted;
+    const uint64_t visited = uint64_t(1) << caves.start;
+    uint64_t part1 = caves.paths(caves.start, visited, true);
+    uint64_t part2 = caves.paths(caves.start, visited, false);
+
+    return {part1, part2};
 }
 
 #ifdef IS_MAIN
@@ -261,4 +202,44 @@ TEST_CASE("day12, part 1 & part 2") {
     CHECK_EQ("99138", output.answer[1]);
 }
 
+TEST_CASE("day12: invalid caves") {
+    // more small caves than bits in the visited mask
+    std::string many = "start-A\nA-end\n";
+    for (int i = 0; i < 64; i++) many += fmt::format("A-c{}\n", std::string(i + 1, 'x'));
+
+    for (std::string edges : {std::string("start-A\nA-B\nB-end\n"), std::string("start-a\na-b\n"), many}) {
+        input_t in = {&edges[0], static_cast<ssize_t>(edges.length())};
+        auto output = day12(in);
+        CHECK_EQ("-", output.answer[0]);
+        CHECK_EQ("-", output.answer[1]);
+    }
+}
+
+TEST_CASE("day12: many small caves") {
+    // start and end plus 12 small caves, all connected to each other through one big cave
+    std::string edges = "start-A\nA-end\n";
+    for (char c = 'a'; c < 'a' + 12; c++) edges += std::string("A-") + c + "\n";
+    input_t in = {&edges[0], static_cast<ssize_t>(edges.length())};
+    auto output = day12(in);
+
+    // part 1: ordered subsets of the 12 caves, sum of 12! / k!
+    uint64_t part1 = 0, factorial = 1;
+    for (int k = 12; k >= 0; k--) {
+        part1 += factorial;
+        factorial *= k;
+    }
+    CHECK_EQ(std::to_string(part1), output.answer[0]);
+
+    // part 2: also one of k visited caves a second time, in (k + 1)! / 2 orders,
+    // sum of binomial(12, k) * k * (k + 1)! / 2
+    uint64_t part2 = part1, binomial = 1;
+    factorial = 1;
+    for (uint64_t k = 1; k <= 12; k++) {
+        binomial = binomial * (12 - k + 1) / k;
+        factorial *= k + 1;
+        part2 += binomial * k * factorial / 2;
+    }
+    CHECK_EQ(std::to_string(part2), output.answer[1]);
+}
+
 #endif  // IS_TEST
@@ -12,46 +12,99 @@ struct Fold {
     }
 };
 
-using Board = std::unordered_set<iPair, std::hash<iPair>>;
-
-void print_small_board(std::stringstream &os, const Board &board) {
-    int32_t y_max = std::numeric_limits<int32_t>().min();
-    int32_t x_max = std::numeric_limits<int32_t>().min();
-    for (auto p : board) {
-        if (p.x > x_max) x_max = p.x;
-        if (p.y > y_max) y_max = p.y;
+/* Folds along x and y are independent, so each axis gets a table of where
+ * every coordinate in [0, size) ends up after all of its folds (-1 on a fold
+ * line). The folds are composed from the last one back: the table before fold
+ * k is the one after it looked up at the folded coordinate. Every fold halves
+ * the paper, so this is O(size) for any number of folds.
+ */
+static std::vector<int32_t> compose(int32_t size, std::span<const int32_t> folds) {
+    std::vector<int32_t> sizes = {size};
+    for (auto p : folds) {
+        assert(2 * p + 1 >= sizes.back());  // nothing is folded beyond 0
+        sizes.push_back(p);
     }
 
-    os << std::endl;
-    for (int32_t y = 0; y <= y_max; y++) {
-        for (int32_t x = 0; x <= x_max; x++) {
-            if (board.contains(iPair(x, y))) {
-                os << "#";
-            } else {
-                os << ".";
+    std::vector<int32_t> map(sizes.back());
+    std::iota(map.begin(), map.end(), 0);
+    for (size_t k = folds.size(); k-- > 0;) {
+        const int32_t p = folds[k];
+        std::vector<int32_t> before(sizes[k]);
+        for (int32_t c = 0; c < sizes[k]; c++) before[c] = c < p ? map[c] : c == p ? -1 : map[2 * p - c];
+        map = std::move(before);
+    }
+    return map;
+}
+
+struct Paper {
+    int32_t width, height;
+    std::vector<uint64_t> dots;  // one bit per position, row by row
+
+    Paper(int32_t width, int32_t height) : width(width), height(height), dots((int64_t(width) * height + 63) / 64) {}
+
+    void set(int32_t x, int32_t y) {
+        auto i = int64_t(y) * width + x;
+        dots[i / 64] |= uint64_t(1) << (i % 64);
+    }
+
+    bool test(int32_t x, int32_t y) const {
+        auto i = int64_t(y) * width + x;
+        return (dots[i / 64] >> (i % 64)) & 1;
+    }
+
+    size_t count() const {
+        size_t n = 0;
+        for (auto word : dots) n += std::popcount(word);
+        return n;
+    }
+
+    // rows and columns up to the last dot
+    void print(std::stringstream &os) const {
+        int32_t x_max = -1, y_max = -1;
+        for (int32_t y = 0; y < height; y++) {
+            for (int32_t x = 0; x < width; x++) {
+                if (test(x, y)) x_max = std::max(x_max, x), y_max = y;
             }
         }
+
         os << std::endl;
+        for (int32_t y = 0; y <= y_max; y++) {
+            for (int32_t x = 0; x <= x_max; x++) os << (test(x, y) ? '#' : '.');
+            os << std::endl;
+        }
     }
+};
+
+static Paper rasterize(std::span<const iPair> points, const std::vector<int32_t> &x_map, const std::vector<int32_t> &y_map) {
+    auto folded_size = [](const std::vector<int32_t> &map) { return map.empty() ? 0 : *std::max_element(map.begin(), map.end()) + 1; };
+    Paper paper(folded_size(x_map), folded_size(y_map));
+    for (auto p : points) {
+        auto x = x_map[p.x], y = y_map[p.y];
+        if (x >= 0 && y >= 0) paper.set(x, y);
+    }
+    return paper;
 }
 
 parse::output_t day13(input_t in) {
     size_t part1 = 0;
     std::string part2;
 
-    Board points;
+    std::vector<iPair> points;
+    int32_t width = 0, height = 0;
 
     while (in.len > 0) {
         auto x = parse::positive<int32_t>(in);
         in.s++, in.len--;
         auto y = parse::positive<int32_t>(in);
-        points.emplace(x, y);
+        points.emplace_back(x, y);
+        width = std::max(width, x + 1);
+        height = std::max(height, y + 1);
         in.s++, in.len--;
         if (*in.s == '\n') break;
     }
 
     std::vector<Fold> folds;
-    folds.reserve(8);
+    folds.reserve(16);
     while (in.len > 8) {
         while (in.len > 0 && *in.s != 'y' && *in.s != 'x') {
             in.s += 1, in.len -= 1;
@@ -62,49 +115,21 @@ parse::output_t day13(input_t in) {
         folds.push_back(Fold{pos, horizontal});
     }
 
-    std::vector<iPair> new_points;
-    new_points.reserve(1024);
-
-    auto apply_fold = [&](const Fold &fold) {
-        new_points.clear();
-        if (fold.horizontal) { /* fold the paper up */
-            for (auto it = points.begin(); it != points.end();) {
-                auto y = it->y;
-                if (y > fold.pos) {
-                    int32_t delta = y - fold.pos;
-                    new_points.emplace_back(it->x, y - 2 * delta);
-                    it = points.erase(it);
-                } else {
-                    it++;
-                }
-            }
-        } else { /* fold left */
-            for (auto it = points.begin(); it != points.end();) {
-                auto x = it->x;
-                if (x > fold.pos) {
-                    int32_t delta = x - fold.pos;
-                    new_points.emplace_back(x - 2 * delta, it->y);
-                    it = points.erase(it);
-                } else {
-                    it++;
-                }
-            }
-        }
-        for (auto p : new_points) {
-            points.insert(std::move(p));
-        }
-    };
-
-    apply_fold(folds[0]);
+    std::vector<int32_t> x_folds, y_folds;
+    for (auto &f : folds) (f.horizontal ? y_folds : x_folds).push_back(f.pos);
 
-    part1 = points.size();
-
-    for (size_t i = 1; i < folds.size(); i++) {
-        apply_fold(folds[i]);
+    // part 1: only the first fold
+    {
+        auto first = std::span(folds[0].horizontal ? y_folds : x_folds).first(1);
+        auto x_map = compose(width, folds[0].horizontal ? std::span<const int32_t>() : first);
+        auto y_map = compose(height, folds[0].horizontal ? first : std::span<const int32_t>());
+        part1 = rasterize(points, x_map, y_map).count();
     }
 
+    auto paper = rasterize(points, compose(width, x_folds), compose(height, y_folds));
+
     std::stringstream ss;
-    print_small_board(ss, points);
+    paper.print(ss);
 
     part2 = ss.str();
 
@@ -177,4 +202,19 @@ TEST_CASE("day13, part 1 & part 2") {
         output.answer[1]);
 }
 
+TEST_CASE("day13: composed folds") {
+    const int32_t folds[] = {655, 327, 163, 81, 40, 20, 10};
+    auto map = compose(1311, folds);
+    REQUIRE(map.size() == 1311);
+
+    for (int32_t c = 0; c < 1311; c++) {
+        int32_t folded = c;
+        for (auto p : folds) {
+            if (folded == p) folded = -1;
+            if (folded > p) folded = 2 * p - folded;
+        }
+        CHECK_EQ(folded, map[c]);
+    }
+}
+
 #endif  // IS_TEST
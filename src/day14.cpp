@@ -3,111 +3,198 @@
 #include <cstdint>
 #include <limits>
 #include <tuple>
-#include <unordered_map>
 
 using parse::input_t;
 
-struct pair_hash {
-    inline std::size_t operator()(const std::pair<char, char> &v) const {
-        return v.first * 31 + v.second;
+// Insertion rules over the letters actually used, pair ab is a * letters + b.
+struct rules_t {
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    std::array<int8_t, 26> index;  // letter - 'A' -> 0 .. letters - 1, -1 if unused
+    std::vector<char> alphabet;
+    // the two pairs a pair turns into in one step, {pair, NONE} if there is no rule for it
+    std::vector<std::array<uint32_t, 2>> children;
+
+    size_t letters() const { return alphabet.size(); }
+    size_t pairs() const { return alphabet.size() * alphabet.size(); }
+    uint32_t pair(int a, int b) const { return a * letters() + b; }
+
+    int letter(char c) {
+        assert(c >= 'A' && c <= 'Z');
+        if (index[c - 'A'] < 0) {
+            index[c - 'A'] = alphabet.size();
+            alphabet.push_back(c);
+        }
+        return index[c - 'A'];
     }
 };
 
-parse::output_t day14(input_t in) {
-    size_t part1 = 0, part2 = 0;
+/* How often every letter is the first of a pair in what a single pair expands
+ * to after n steps: response[c * pairs + p]. With M the transition matrix
+ * (column p holds the children of pair p) and L mapping pairs to their first
+ * letter, this is L M^n. Nearby step counts are reached by stepping the
+ * response, R_n+1(p) = R_n(child 1) + R_n(child 2); far ones by repeated
+ * squaring of M, where the squares are kept for later queries.
+ */
+template <typename T>
+class expansion_t {
+   private:
+    const rules_t &m_rules;
+    size_t m_steps = 0;
+    std::vector<T> m_response;
+    std::vector<std::vector<T>> m_squares;  // M^(2^i), pairs x pairs
 
-    std::unordered_map<std::pair<char, char>, char, pair_hash> rules;
-    rules.reserve(100);
-
-    std::unordered_map<std::pair<char, char>, int64_t, pair_hash> polymers[2];
-    polymers[0].reserve(26 * 26);
-    polymers[1].reserve(26 * 26);
-
-    std::unordered_map<char, int64_t> frequencies;
-    frequencies.reserve(26);
-
-    {
-        size_t counter;
-        for (counter = 0; *(in.s + counter) != '\n'; counter++)
-            ;
-        assert(counter > 0);
-        for (size_t i = 0; i < counter - 1; i++) {
-            char c1 = *(in.s + i);
-            char c2 = *(in.s + i + 1);
-            frequencies[c1] += 1;
-            polymers[0][std::make_pair(c1, c2)]++;
+    // a (rows x pairs) times b (pairs x pairs)
+    std::vector<T> multiply(const std::vector<T> &a, const std::vector<T> &b) const {
+        const size_t n = m_rules.pairs(), rows = a.size() / n;
+        std::vector<T> c(rows * n);
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t k = 0; k < n; k++) {
+                const T x = a[i * n + k];
+                if (x == T(0)) continue;
+                for (size_t j = 0; j < n; j++) c[i * n + j] += x * b[k * n + j];
+            }
         }
-        frequencies[*(in.s + counter - 1)] += 1;
-        in.s += counter, in.len -= counter;
+        return c;
     }
 
-    while (in.len > 6) {
-        while (in.len > 0 && (*in.s < 'A' || *in.s > 'Z')) {
-            in.s++, in.len--;
+    void step() {
+        const size_t n = m_rules.pairs();
+        std::vector<T> next(m_response.size());
+        for (size_t c = 0; c < m_rules.letters(); c++) {
+            const T *r = &m_response[c * n];
+            for (size_t p = 0; p < n; p++) {
+                auto [q1, q2] = m_rules.children[p];
+                next[c * n + p] = q2 == rules_t::NONE ? r[q1] : r[q1] + r[q2];
+            }
         }
-        auto lhs1 = *in.s;
-        in.s++, in.len--;
-        auto lhs2 = *in.s;
-        in.s += 5, in.len -= 5;
-        auto rhs = *in.s;
-        in.s++, in.len--;
-
-        assert(lhs1 >= 'A' && lhs1 <= 'Z');
-        assert(lhs2 >= 'A' && lhs2 <= 'Z');
-        assert(rhs >= 'A' && rhs <= 'Z');
-
-        rules[std::make_pair(lhs1, lhs2)] = rhs;
+        m_response = std::move(next);
+        m_steps++;
+    }
+
+   public:
+    expansion_t(const rules_t &rules) : m_rules(rules), m_response(rules.letters() * rules.pairs()) {
+        for (size_t p = 0; p < rules.pairs(); p++) m_response[(p / rules.letters()) * rules.pairs() + p] = 1;
     }
 
-    uint8_t activeidx = 0;
-    uint8_t inactiveidx = 1;
-
-    constexpr uint16_t TOTAL_STEPS = 40;
-    for (uint16_t step = 1; step <= TOTAL_STEPS; ++step) {
-        polymers[inactiveidx].clear();
-
-        for (auto const &kv : polymers[activeidx]) {
-            const auto count = kv.second;
-            auto got = rules.find(kv.first);
-            if (got != rules.end()) {  // found, so split it
-                char split = got->second;
-                char first = kv.first.first;
-                char second = kv.first.second;
-
-                frequencies[split] += count;
-                polymers[inactiveidx][std::make_pair(first, split)] += count;
-                polymers[inactiveidx][std::make_pair(split, second)] += count;
-            } else {  // not found, so just keep it unless
-                polymers[inactiveidx][kv.first] += count;
+    // L M^steps by repeated squaring
+    std::vector<T> power(size_t steps) {
+        const size_t n = m_rules.pairs();
+        if (m_squares.empty()) {
+            std::vector<T> m(n * n);
+            for (size_t p = 0; p < n; p++) {
+                for (auto q : m_rules.children[p]) {
+                    if (q != rules_t::NONE) m[q * n + p] += 1;
+                }
             }
+            m_squares.push_back(std::move(m));
+        }
+
+        std::vector<T> r(m_rules.letters() * n);
+        for (size_t p = 0; p < n; p++) r[(p / m_rules.letters()) * n + p] = 1;
+        for (size_t i = 0; steps; i++, steps >>= 1) {
+            if (i == m_squares.size()) m_squares.push_back(multiply(m_squares[i - 1], m_squares[i - 1]));
+            if (steps & 1) r = multiply(r, m_squares[i]);
         }
-        activeidx = (activeidx + 1) % 2;
-        inactiveidx = (inactiveidx + 1) % 2;
-
-        if (step == 10) {
-            auto max = std::numeric_limits<int64_t>().min();
-            auto min = std::numeric_limits<int64_t>().max();
-            for (const auto &kv : frequencies) {
-                if (kv.second > max) max = kv.second;
-                if (kv.second < min) min = kv.second;
+        return r;
+    }
+
+    const std::vector<T> &response(size_t steps) {
+        // stepping this far costs about as much as one squaring
+        const size_t limit = m_rules.pairs() * m_rules.letters();
+        if (steps < m_steps || steps - m_steps > limit) {
+            m_response = power(steps);
+            m_steps = steps;
+        }
+        while (m_steps < steps) step();
+        return m_response;
+    }
+
+    // letter counts of the polymer with the given pair counts and last letter
+    std::vector<T> letters(const std::vector<T> &pairs, int last, size_t steps) {
+        const auto &r = response(steps);
+        const size_t n = m_rules.pairs();
+        std::vector<T> counts(m_rules.letters());
+        for (size_t c = 0; c < counts.size(); c++) {
+            for (size_t p = 0; p < n; p++) {
+                if (!(pairs[p] == T(0))) counts[c] += pairs[p] * r[c * n + p];
             }
-            assert(max >= min);
-            part1 = max - min;
         }
+        counts[last] += 1;
+        return counts;
     }
+};
 
-    auto max = std::numeric_limits<int64_t>().min();
-    auto min = std::numeric_limits<int64_t>().max();
-    for (const auto &kv : frequencies) {
-        if (kv.second > max) max = kv.second;
-        if (kv.second < min) min = kv.second;
+// most minus least common letter
+static uint64_t spread(const std::vector<uint64_t> &counts) {
+    uint64_t max = 0, min = std::numeric_limits<uint64_t>::max();
+    for (auto c : counts) {
+        if (!c) continue;  // letters only used by rules which never apply
+        max = std::max(max, c);
+        min = std::min(min, c);
     }
     assert(max >= min);
-    part2 = max - min;
+    return max - min;
+}
+
+template <typename Input>
+static parse::output_t solve(Input &in) {
+    size_t part1 = 0, part2 = 0;
+
+    rules_t rules;
+    rules.index.fill(-1);
+
+    // the template is consumed pair by pair, so its length is not bounded by the buffer
+    std::array<uint64_t, 26 * 26> template_pairs{};
+    char first = parse::peek(in), last = first;
+    assert(first >= 'A' && first <= 'Z');
+    parse::skip(in, 1);
+    rules.letter(first);
+    while (parse::more(in) && parse::peek(in) != '\n') {
+        char c = parse::peek(in);
+        parse::skip(in, 1);
+        rules.letter(c);
+        template_pairs[(last - 'A') * 26 + c - 'A']++;
+        last = c;
+    }
+
+    std::vector<std::array<int, 3>> insertions;
+    while (parse::more(in)) {
+        while (parse::more(in) && (parse::peek(in) < 'A' || parse::peek(in) > 'Z')) {
+            parse::skip(in, 1);
+        }
+        if (!parse::more(in)) break;
+        auto lhs1 = parse::peek(in);
+        parse::skip(in, 1);
+        auto lhs2 = parse::peek(in);
+        parse::skip(in, 5);
+        auto rhs = parse::peek(in);
+        parse::skip(in, 1);
+        insertions.push_back({rules.letter(lhs1), rules.letter(lhs2), rules.letter(rhs)});
+    }
+
+    rules.children.resize(rules.pairs());
+    for (uint32_t p = 0; p < rules.pairs(); p++) rules.children[p] = {p, rules_t::NONE};
+    for (auto [a, b, x] : insertions) rules.children[rules.pair(a, b)] = {rules.pair(a, x), rules.pair(x, b)};
+
+    std::vector<uint64_t> pairs(rules.pairs());
+    for (int a = 0; a < 26; a++) {
+        for (int b = 0; b < 26; b++) {
+            if (template_pairs[a * 26 + b]) pairs[rules.pair(rules.index[a], rules.index[b])] = template_pairs[a * 26 + b];
+        }
+    }
+
+    expansion_t<uint64_t> expansion(rules);
+    part1 = spread(expansion.letters(pairs, rules.index[last - 'A'], 10));
+    part2 = spread(expansion.letters(pairs, rules.index[last - 'A'], 40));
 
     return {part1, part2};
 }
 
+parse::output_t day14(input_t in) { return solve(in); }
+
+parse::output_t day14_stream(parse::stream_t &in) { return solve(in); }
+
 #ifdef IS_MAIN
 int main() {
     input_t in = parse::load_input("input/day14.txt");
@@ -120,6 +207,7 @@ int main() {
 #ifdef IS_TEST
 
 #include <doctest/doctest.h>
+#include <testing.h>
 
 using std::make_tuple;
 
@@ -153,6 +241,10 @@ TEST_CASE("day14: examples") {
         auto output = day14(in);
         CHECK_EQ(std::get<1>(tc), output.answer[0]);
         CHECK_EQ(std::get<2>(tc), output.answer[1]);
+
+        auto streamed = solve_streamed(first, day14_stream, 8);
+        CHECK_EQ(std::get<1>(tc), streamed.answer[0]);
+        CHECK_EQ(std::get<2>(tc), streamed.answer[1]);
     }
 }
 
@@ -163,4 +255,34 @@ TEST_CASE("day14, part 1 & part 2") {
     CHECK_EQ("3572761917024", output.answer[1]);
 }
 
+TEST_CASE("day14: stepping and squaring agree") {
+    // NNCB with the example rules, over the letters N, C, B, H
+    rules_t rules;
+    rules.index.fill(-1);
+    for (char c : std::string("NCBH")) rules.letter(c);
+    rules.children.resize(rules.pairs());
+    for (uint32_t p = 0; p < rules.pairs(); p++) rules.children[p] = {p, rules_t::NONE};
+    const char *insertions[] = {"CHB", "HHN", "CBH", "NHC", "HBC", "HCB", "HNC", "NNC",
+                                "BHH", "NCB", "NBB", "BNB", "BBN", "BCB", "CCN", "CNC"};
+    for (auto i : insertions) {
+        int a = rules.letter(i[0]), b = rules.letter(i[1]), x = rules.letter(i[2]);
+        rules.children[rules.pair(a, b)] = {rules.pair(a, x), rules.pair(x, b)};
+    }
+
+    std::vector<uint128_t> pairs(rules.pairs());
+    pairs[rules.pair(0, 0)] = pairs[rules.pair(0, 1)] = pairs[rules.pair(1, 2)] = 1;
+
+    expansion_t<uint128_t> stepped(rules), squared(rules);
+    for (size_t steps : {0, 1, 10, 40, 100}) CHECK(stepped.response(steps) == squared.power(steps));
+
+    // 128 bits last for about 125 steps here, modular counts for any number
+    auto counts = stepped.letters(pairs, rules.letter('B'), 40);
+    CHECK_EQ("2192039569602", to_string(counts[rules.letter('B')]));
+    CHECK_EQ("3849876073", to_string(counts[rules.letter('H')]));
+
+    expansion_t<modular<1000000007>> a(rules), b(rules);
+    CHECK(a.response(1000) == b.power(1000));
+    CHECK(a.response(1010) == b.response(1010));
+}
+
 #endif  // IS_TEST
@@ -2,132 +2,83 @@
 
 using parse::input_t;
 
-const int MAX_ROWS = 500;
-const int MAX_COLS = 500;
-const size_t MAXV = 1 + MAX_COLS * MAX_ROWS;
-
-static int8_t grid[MAX_ROWS][MAX_COLS];
-static int cols = 0;
-static int rows = 0;
-
-// 2d to 1d, one-based
-inline int encode(int x, int y) {
-    return y * cols + x;
-}
-// 1d to 2d
-inline iPair decode(int index) {
-    int y = index / cols;
-    int x = index % cols;
-    return iPair(x, y);
-}
-
-void edges(iPair p, int neighbors[], int *count) {
-    auto x = p.x;
-    auto y = p.y;
-    int i = 0;
-    if (x > 0) neighbors[i++] = encode(x - 1, y);
-    if (x + 1 < cols) neighbors[i++] = encode(x + 1, y);
-    if (y > 0) neighbors[i++] = encode(x, y - 1);
-    if (y + 1 < rows) neighbors[i++] = encode(x, y + 1);
-    *count = i;
-}
-
-struct PQNode {
-    int32_t distance;
-    int32_t value;
-
-    PQNode(int32_t distance, int32_t value) : distance(distance), value(value) {}
-
-    inline bool operator>(const PQNode &other) const {
-        return distance > other.distance;
-    }
+struct cave_t {
+    int cols, rows;
+    std::vector<uint8_t> risk;  // of the tile, 1 .. 9
 };
 
-/*
- *  Based on https://www.geeksforgeeks.org/dijkstras-shortest-path-algorithm-using-priority_queue-stl/
- */
-void dijkstra(int x_start, int y_start, int distance[], int parent[]) {
-    constexpr int MAXINT = std::numeric_limits<int>().max() >> 1;
-
-    std::priority_queue<PQNode, std::vector<PQNode>, std::greater<PQNode>> pq;
-
-    const int nvertices = 1 + encode(rows - 1, cols - 1);
-
-    for (int i = 0; i < nvertices; i++) {
-        distance[i] = MAXINT;
-        parent[i] = -1;
+static cave_t parse_cave(input_t in) {
+    auto newline = static_cast<const char *>(memchr(in.s, '\n', in.len));
+    cave_t cave;
+    cave.cols = newline ? newline - in.s : in.len;
+    cave.rows = (in.len + 1) / (cave.cols + 1);
+    cave.risk.resize(cave.cols * cave.rows);
+    for (int y = 0; y < cave.rows; y++) {
+        for (int x = 0; x < cave.cols; x++) cave.risk[y * cave.cols + x] = in.s[y * (cave.cols + 1) + x] - '0';
     }
+    return cave;
+}
 
-    int start = encode(x_start, y_start);
-    pq.push(PQNode(0, start));
-    distance[start] = 0;
-
-    int neighbors[4];
-    int neighbors_count;
-
-    while (!pq.empty()) {
-        int v = pq.top().value;
-        pq.pop();
-        auto v2d = decode(v);
-        edges(v2d, neighbors, &neighbors_count);
-        for (int idx = 0; idx < neighbors_count; idx++) {
-            auto w = neighbors[idx];
-            auto w2d = decode(w);
-            auto weight = grid[w2d.y][w2d.x];
-            auto alt = distance[v] + weight;
-            if (distance[w] > alt) {
-                // Update distance
-                distance[w] = alt;
-                parent[w] = v;
-                pq.push(PQNode(distance[w], w));
-            }
+/* Dial's algorithm: risks are 1 .. 9, so the distances of all queued vertices
+ * lie within [d, d + 9] of the current one and 10 buckets indexed by distance
+ * mod 10 form the priority queue. The cave is tiled `factor` times in each
+ * direction without expanding it: the risk of a cell is looked up in the tile
+ * and wrapped around by the tile's offset, via per-row and per-column tables.
+ */
+static uint32_t lowest_risk(const cave_t &cave, int factor) {
+    const int width = cave.cols * factor, height = cave.rows * factor;
+
+    // tile-local coordinate and tile offset of every column and row
+    std::vector<int> col_base(width), col_tile(width), row_base(height), row_tile(height);
+    for (int x = 0; x < width; x++) col_base[x] = x % cave.cols, col_tile[x] = x / cave.cols;
+    for (int y = 0; y < height; y++) row_base[y] = (y % cave.rows) * cave.cols, row_tile[y] = y / cave.rows;
+
+    // risk + offset -> wrapped risk, 9 wraps around to 1
+    std::vector<uint8_t> wrap(10 + 2 * factor);
+    for (size_t r = 1; r < wrap.size(); r++) wrap[r] = (r - 1) % 9 + 1;
+
+    auto risk = [&](int x, int y) { return wrap[cave.risk[row_base[y] + col_base[x]] + row_tile[y] + col_tile[x]]; };
+
+    constexpr uint32_t INF = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> distance(size_t(width) * height, INF);
+    std::array<std::vector<uint32_t>, 10> buckets;
+
+    const uint32_t target = distance.size() - 1;
+    distance[0] = 0;
+    buckets[0].push_back(0);
+
+    for (uint32_t d = 0;; d++) {
+        auto &bucket = buckets[d % 10];
+        // relaxing adds to other buckets only, as risks are at least 1
+        for (size_t i = 0; i < bucket.size(); i++) {
+            const uint32_t v = bucket[i];
+            if (distance[v] != d) continue;  // stale
+            if (v == target) return d;
+
+            const int x = v % width, y = v / width;
+            auto relax = [&](int nx, int ny) {
+                const uint32_t w = ny * width + nx;
+                const uint32_t alt = d + risk(nx, ny);
+                if (alt < distance[w]) {
+                    distance[w] = alt;
+                    buckets[alt % 10].push_back(w);
+                }
+            };
+            if (x > 0) relax(x - 1, y);
+            if (x + 1 < width) relax(x + 1, y);
+            if (y > 0) relax(x, y - 1);
+            if (y + 1 < height) relax(x, y + 1);
         }
+        bucket.clear();
     }
 }
 
 parse::output_t day15(input_t in) {
     long part1 = 0, part2 = 0;
 
-    int distance[MAXV]; /* distance vertex is from start */
-    int parent[MAXV];   /* distance vertex is from start */
-
-    while (in.len > 0) {
-        cols = 0;
-        while (*in.s >= '0' && *in.s <= '9') {
-            grid[rows][cols++] = parse::positive<int8_t>(in, 1, false);
-        }
-        in.s++, in.len--;
-        rows++;
-    }
-    assert(rows > 0 && rows <= MAX_ROWS / 5);
-    assert(cols > 0 && cols <= MAX_COLS / 5);
-
-    auto last_part1 = encode(cols - 1, rows - 1);
-    dijkstra(0, 0, distance, parent);
-    part1 = distance[last_part1];
-
-    const auto width = cols;
-
-    // grow grid
-    cols *= 5;
-    rows *= 5;
-    for (int y = 0; y < rows; y++) {
-        for (int x = 0; x < cols; x++) {
-            if (x < width && y < width) continue;
-            if (x >= width) {  // take left value;
-                grid[y][x] = (grid[y][x - width] + 1);
-            } else {
-                assert(y >= width);
-                // take upper value
-                grid[y][x] = (grid[y - width][x] + 1);
-            }
-            if (grid[y][x] > 9) grid[y][x] = 1;
-        }
-    }
-
-    auto last_part2 = encode(cols - 1, rows - 1);
-    dijkstra(0, 0, distance, parent);
-    part2 = distance[last_part2];
+    auto cave = parse_cave(in);
+    part1 = lowest_risk(cave, 1);
+    part2 = lowest_risk(cave, 5);
 
     return {part1, part2};
 }
@@ -148,16 +99,6 @@ int main() {
 
 using std::make_tuple;
 
-void reset_state() {
-    for (size_t i = 0; i < MAX_ROWS; i++) {
-        for (size_t j = 0; j < MAX_COLS; j++) {
-            grid[i][j] = 0;
-        }
-    }
-    cols = 0;
-    rows = 0;
-}
-
 TEST_CASE("day15: examples") {
     auto test_cases = {
         make_tuple(
@@ -175,7 +116,6 @@ TEST_CASE("day15: examples") {
     };
 
     for (auto &tc : test_cases) {
-        reset_state();
         auto first = std::string(std::get<0>(tc));
         DEBUG("Input:\n{}", &first);
         input_t in = {&first[0], static_cast<ssize_t>(first.length())};
@@ -189,11 +129,43 @@ TEST_CASE("day15: examples") {
 }
 
 TEST_CASE("day15, part 1 & part 2") {
-    reset_state();
     input_t in = parse::load_input("input/day15.txt");
     auto output = day15(in);
     CHECK_EQ("687", output.answer[0]);
     CHECK_EQ("2957", output.answer[1]);
 }
 
+TEST_CASE("day15: any tile factor") {
+    std::string example =
+        "1163751742\n1381373672\n2136511328\n3694931569\n7463417111\n"
+        "1319128137\n1359912421\n3125421639\n1293138521\n2311944581";
+    auto cave = parse_cave({&example[0], static_cast<ssize_t>(example.length())});
+
+    // Dijkstra with a binary heap on the expanded cave
+    auto reference = [&](int factor) {
+        const int w = cave.cols * factor, h = cave.rows * factor;
+        std::vector<int> distance(w * h, std::numeric_limits<int>::max());
+        std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<>> pq;
+        distance[0] = 0;
+        pq.emplace(0, 0);
+        while (!pq.empty()) {
+            auto [d, v] = pq.top();
+            pq.pop();
+            if (d > distance[v]) continue;
+            const int x = v % w, y = v / w;
+            for (auto [nx, ny] : {std::pair(x - 1, y), std::pair(x + 1, y), std::pair(x, y - 1), std::pair(x, y + 1)}) {
+                if (nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
+                int r = (cave.risk[(ny % cave.rows) * cave.cols + nx % cave.cols] - 1 + nx / cave.cols + ny / cave.rows) % 9 + 1;
+                if (d + r < distance[ny * w + nx]) {
+                    distance[ny * w + nx] = d + r;
+                    pq.emplace(d + r, ny * w + nx);
+                }
+            }
+        }
+        return static_cast<uint32_t>(distance.back());
+    };
+
+    for (int factor : {1, 2, 5, 13, 50}) CHECK_EQ(reference(factor), lowest_risk(cave, factor));
+}
+
 #endif  // IS_TEST
@@ -4,226 +4,151 @@ using parse::input_t;
 
 namespace day16_internal {
 
-struct Packet; /* forward decl */
-
-struct Payload {
-    uint64_t value;
-    std::vector<Packet> children;
-};
-
-struct Packet {
-    /* header */
-    uint8_t version;
-    uint8_t type_id;
-    Payload payload;
-
-    inline bool is_literal() const {
-        return type_id == 4;
-    }
-
-    inline bool is_operator() const {
-        return !is_literal();
-    }
-};
-
-const char* hex_to_binary(char hex) {
-    switch (hex) {
-        case '0':
-            return "0000";
-        case '1':
-            return "0001";
-        case '2':
-            return "0010";
-        case '3':
-            return "0011";
-        case '4':
-            return "0100";
-        case '5':
-            return "0101";
-        case '6':
-            return "0110";
-        case '7':
-            return "0111";
-        case '8':
-            return "1000";
-        case '9':
-            return "1001";
-        case 'A':
-            return "1010";
-        case 'B':
-            return "1011";
-        case 'C':
-            return "1100";
-        case 'D':
-            return "1101";
-        case 'E':
-            return "1110";
-        case 'F':
-            return "1111";
-    }
-    std::string msg("Unable to convert hex char: ");
-    msg += hex;
-    throw std::invalid_argument(msg);
-}
-
-struct ParseResult {
-    Packet packet;
-    size_t bytes_read;
-};
-
-ParseResult parse_packet_bin(std::span<char> binary) {
-    ParseResult result;
-
-    auto it = binary.begin();
-    auto get_offset = [&]() -> size_t {
-        return it - binary.begin();
-    };
-
-    // the first three bits encode the packet *version*
-    result.packet.version = 0;
-    for (int i = 0; i <= 2; ++i) {
-        if (*it == '1') result.packet.version |= 1 << (2 - i);
-        ++it;
-    }
-
-    // the next three bits encode the packet *type ID*
-    result.packet.type_id = 0;
-    for (int i = 0; i <= 2; ++i) {
-        if (*it == '1') result.packet.type_id |= 1 << (2 - i);
-        ++it;
+// Reads the transmission MSB first straight from its hex digits. The next
+// `count` bits are the low bits of `buffer`, refilled 8 digits at a time.
+class bit_reader_t {
+   private:
+    const char *m_s, *m_end;
+    uint64_t m_buffer = 0;
+    int m_count = 0;
+    uint64_t m_consumed = 0;
+
+    static uint8_t hex(char c) { return (c & 0xf) + 9 * (c >> 6 & 1); }
+
+    void refill() {
+        if (m_count <= 32 && m_end - m_s >= 8) {
+            // SWAR: one digit value per byte, first digit in the highest byte, then pack the nibbles
+            uint64_t v;
+            memcpy(&v, m_s, 8);
+            v = __builtin_bswap64((v & 0x0f0f0f0f0f0f0f0f) + 9 * ((v >> 6) & 0x0101010101010101));
+            v = (v | v >> 4) & 0x00ff00ff00ff00ff;
+            v = (v | v >> 8) & 0x0000ffff0000ffff;
+            v = (v | v >> 16) & 0x00000000ffffffff;
+            m_buffer = m_buffer << 32 | v;
+            m_count += 32;
+            m_s += 8;
+        }
+        while (m_count <= 60 && m_s < m_end) {
+            m_buffer = m_buffer << 4 | hex(*m_s++);
+            m_count += 4;
+        }
     }
 
-    if (result.packet.is_literal()) {
-        std::stringstream ss;
-        bool is_last = false;
-        while (!is_last) {
-            is_last = *it == '0';
-            ++it;
-            for (int i = 0; i <= 3; ++i) {
-                ss << *it;
-                ++it;
-            }
-        };
-        auto s = ss.str();
-        result.packet.payload.value = std::stol(s, 0, 2);
-    } else {
-        uint8_t length_type_id = *it - '0';
-        ++it;
-        assert(length_type_id == 0 || length_type_id == 1);
-        if (length_type_id == 0) {
-            // the next *15* bits are a number that represents the *total length in bits* of the sub-packets contained by this packet
-            size_t subpackets_len = 0;
-            for (int i = 0; i <= 14; ++i) {
-                if (*it == '1') subpackets_len |= 1 << (14 - i);
-                ++it;
-            }
-            auto end = get_offset() + subpackets_len;
-            while (get_offset() < end) {
-                std::span<char> sub_binary(it, binary.end());
-                auto child_result = parse_packet_bin(sub_binary);
-                it += child_result.bytes_read;
-                result.packet.payload.children.push_back(child_result.packet);
-            }
-
-        } else {
-            // the next *11* bits are a number that represents the *number of sub-packets immediately contained* by this packet
-            size_t subpackets_count = 0;
-            for (int i = 0; i <= 10; ++i) {
-                if (*it == '1') subpackets_count |= 1 << (10 - i);
-                ++it;
-            }
-            for (size_t i = 0; i < subpackets_count; i++) {
-                std::span<char> sub_binary(it, binary.end());
-                auto child_result = parse_packet_bin(sub_binary);
-                it += child_result.bytes_read;
-                result.packet.payload.children.push_back(child_result.packet);
-            }
+   public:
+    bit_reader_t(std::span<const char> hex) : m_s(hex.data()), m_end(hex.data() + hex.size()) {}
+
+    // n <= 32, zeros past the end
+    uint32_t read(int n) {
+        if (m_count < n) refill();
+        m_consumed += n;
+        if (m_count < n) {
+            uint32_t value = (m_buffer & ((uint64_t(1) << m_count) - 1)) << (n - m_count);
+            m_count = 0;
+            return value;
         }
+        m_count -= n;
+        return (m_buffer >> m_count) & ((uint64_t(1) << n) - 1);
     }
 
-    result.bytes_read = get_offset();
-    return result;
-}
-
-Packet parse_packet_hex(std::span<const char> hexstring) {
-    DEBUG("parsing hex: {}", std::string(hexstring.begin(), hexstring.end()));
-    constexpr size_t MAX_LEN = 6000;
-
-    char buf[MAX_LEN];
-    size_t n = 0;
-
-    for (auto c : hexstring) {
-        auto bin = hex_to_binary(c);
-        assert(n < MAX_LEN - 1);
-        for (int i = 0; i < 4; ++i) buf[n++] = *(bin + i);
-    }
+    uint64_t consumed() const { return m_consumed; }
+};
 
-    std::span<char> binary(buf, n);
-    return parse_packet_bin(binary).packet;
-}
+struct Result {
+    uint64_t version_sum;
+    uint64_t value;
+};
 
-uint64_t version_sum(const Packet& packet) {
-    uint64_t sum = packet.version;
-    if (packet.is_literal()) {
-        return sum;
-    }
-    for (const auto& child : packet.payload.children) {
-        sum += day16_internal::version_sum(child);
-    }
-    return sum;
-}
+// an operator packet whose sub-packets are being evaluated
+struct Frame {
+    uint8_t type_id;
+    bool by_length;  // limit is the bit position of its end, otherwise the number of sub-packets left
+    uint64_t limit;
+    uint64_t value;
+    bool empty;  // no sub-packet yet
+};
 
-uint64_t eval(const Packet& packet) {
-    using namespace day16_internal;
-    if (packet.is_literal()) {
-        return packet.payload.value;
+static void combine(Frame &f, uint64_t v) {
+    if (f.empty) {
+        f.value = v;
+        f.empty = false;
+        return;
     }
-    uint64_t result;
-    switch (packet.type_id) {
+    switch (f.type_id) {
         case 0:
-            result = 0;
-            for (const auto& child : packet.payload.children) result += eval(child);
+            f.value += v;
             break;
         case 1:
-            result = 1;
-            for (const auto& child : packet.payload.children) result *= eval(child);
+            f.value *= v;
             break;
         case 2:
-            result = std::numeric_limits<uint64_t>().max();
-            for (const auto& child : packet.payload.children) result = std::min(result, eval(child));
+            f.value = std::min(f.value, v);
             break;
         case 3:
-            result = std::numeric_limits<uint64_t>().min();
-            for (const auto& child : packet.payload.children) result = std::max(result, eval(child));
+            f.value = std::max(f.value, v);
             break;
         case 5:
-            result = eval(packet.payload.children[0]) > eval(packet.payload.children[1]) ? 1 : 0;
+            f.value = f.value > v;
             break;
         case 6:
-            result = eval(packet.payload.children[0]) < eval(packet.payload.children[1]) ? 1 : 0;
+            f.value = f.value < v;
             break;
         case 7:
-            result = eval(packet.payload.children[0]) == eval(packet.payload.children[1]) ? 1 : 0;
+            f.value = f.value == v;
             break;
         default:
             throw std::invalid_argument("unsupported type_id");
     }
-    return result;
+}
+
+/* Decodes and evaluates the outermost packet in a single pass: the operators
+ * whose sub-packets are still being read are kept on an explicit stack, and
+ * every value is folded into its parent as soon as it is known.
+ */
+Result evaluate(std::span<const char> hex) {
+    bit_reader_t bits(hex);
+    std::vector<Frame> stack;
+    stack.reserve(64);
+
+    uint64_t version_sum = 0;
+    while (true) {
+        version_sum += bits.read(3);
+        const uint8_t type_id = bits.read(3);
+
+        if (type_id != 4) {
+            const bool by_length = bits.read(1) == 0;
+            const uint64_t limit = by_length ? bits.read(15) + bits.consumed() : bits.read(11);
+            stack.push_back({type_id, by_length, limit, 0, true});
+            continue;
+        }
+
+        uint64_t value = 0;
+        for (uint32_t group = 16; group & 16;) {
+            group = bits.read(5);
+            value = value << 4 | (group & 15);
+        }
+
+        // fold into the parents, completing those which got their last sub-packet
+        while (true) {
+            if (stack.empty()) return {version_sum, value};
+            auto &top = stack.back();
+            combine(top, value);
+            const bool done = top.by_length ? bits.consumed() >= top.limit : --top.limit == 0;
+            if (!done) break;
+            value = top.value;
+            stack.pop_back();
+        }
+    }
 }
 
 }  // namespace day16_internal
 
 parse::output_t day16(input_t in) {
     using namespace day16_internal;
-    uint64_t part1 = 0, part2 = 0;
 
     if (*(in.s + in.len - 1) == '\n') in.len--;
-    std::span<const char> input(in.s, in.len);
-    Packet packet = parse_packet_hex(input);
-    part1 = version_sum(packet);
-    part2 = eval(packet);
+    auto result = evaluate(std::span<const char>(in.s, in.len));
 
-    return {part1, part2};
+    return {result.version_sum, result.value};
 }
 
 #ifdef IS_MAIN
@@ -243,41 +168,62 @@ using std::make_tuple;
 using namespace day16_internal;
 
 TEST_CASE("day16: literal packet") {
-    std::string s("D2FE28");
-    std::span<char> input_hex(&s[0], s.length());
-    auto p = parse_packet_hex(input_hex);
-    CHECK_EQ(6, p.version);
-    CHECK_EQ(4, p.type_id);
-    CHECK_EQ(true, p.is_literal());
-    CHECK_EQ(false, p.is_operator());
-    CHECK_EQ(2021, p.payload.value);
+    auto r = evaluate(std::string_view("D2FE28"));
+    CHECK_EQ(6u, r.version_sum);
+    CHECK_EQ(2021u, r.value);
 }
 
 TEST_CASE("day16: operator packet with length type ID 0 that contains two sub-packets") {
-    std::string s("38006F45291200");
-    std::span<char> input_hex(&s[0], s.length());
-    auto p = parse_packet_hex(input_hex);
-    CHECK_EQ(1, p.version);
-    CHECK_EQ(6, p.type_id);
-    CHECK_EQ(false, p.is_literal());
-    CHECK_EQ(true, p.is_operator());
-    CHECK_EQ(2, p.payload.children.size());
-    CHECK_EQ(10, p.payload.children[0].payload.value);
-    CHECK_EQ(20, p.payload.children[1].payload.value);
+    // 10 < 20
+    auto r = evaluate(std::string_view("38006F45291200"));
+    CHECK_EQ(1u + 6 + 2, r.version_sum);
+    CHECK_EQ(1u, r.value);
 }
 
 TEST_CASE("day16: operator packet with length type ID 1 that contains three sub-packets") {
-    std::string s("EE00D40C823060");
-    std::span<char> input_hex(&s[0], s.length());
-    auto p = parse_packet_hex(input_hex);
-    CHECK_EQ(7, p.version);
-    CHECK_EQ(3, p.type_id);
-    CHECK_EQ(false, p.is_literal());
-    CHECK_EQ(true, p.is_operator());
-    CHECK_EQ(3, p.payload.children.size());
-    CHECK_EQ(1, p.payload.children[0].payload.value);
-    CHECK_EQ(2, p.payload.children[1].payload.value);
-    CHECK_EQ(3, p.payload.children[2].payload.value);
+    // max(1, 2, 3)
+    auto r = evaluate(std::string_view("EE00D40C823060"));
+    CHECK_EQ(7u + 2 + 4 + 1, r.version_sum);
+    CHECK_EQ(3u, r.value);
+}
+
+TEST_CASE("day16: multi-megabyte transmission") {
+    // a sum of 300 sums of 2047 literals each, nested by count and by length
+    std::string bits;
+    auto write = [&](uint64_t value, int n) {
+        for (int i = n - 1; i >= 0; i--) bits += (value >> i) & 1 ? '1' : '0';
+    };
+    uint64_t expected = 0;
+    write(1, 3), write(0, 3), write(1, 1), write(300, 11);
+    for (int i = 0; i < 300; i++) {
+        write(2, 3), write(0, 3);
+        size_t length_at = 0;
+        if (i % 2) {
+            write(1, 1), write(2047, 11);
+        } else {
+            write(0, 1);
+            length_at = bits.size();
+            write(0, 15);  // filled in below
+        }
+        auto start = bits.size();
+        for (int j = 0; j < (i % 2 ? 2047 : 1500); j++) {
+            write(3, 3), write(4, 3), write(0x10 | (j & 15), 5), write(j >> 4 & 15, 5);
+            expected += (j & 15) << 4 | (j >> 4 & 15);
+        }
+        if (i % 2 == 0) {
+            auto length = bits.size() - start;
+            for (int b = 0; b < 15; b++) bits[length_at + b] = (length >> (14 - b)) & 1 ? '1' : '0';
+        }
+    }
+    bits.resize((bits.size() + 3) / 4 * 4, '0');
+
+    std::string hex;
+    for (size_t i = 0; i < bits.size(); i += 4) hex += "0123456789ABCDEF"[std::stoi(bits.substr(i, 4), nullptr, 2)];
+    REQUIRE(hex.size() > (1 << 20));
+
+    auto r = evaluate(hex);
+    CHECK_EQ(expected, r.value);
+    CHECK_EQ(1u + 300 * 2 + (150 * 2047 + 150 * 1500) * 3, r.version_sum);
 }
 
 TEST_CASE("day16: examples part 1") {
@@ -2,20 +2,6 @@
 
 using parse::input_t;
 
-struct Probe {
-    int32_t x, y, x_velocity, y_velocity;
-
-    void step() {
-        x += x_velocity, y += y_velocity;
-        if (x_velocity > 0) {
-            x_velocity--;
-        } else if (x_velocity < 0) {
-            x_velocity++;
-        }
-        y_velocity--;
-    }
-};
-
 struct TargetArea {
     int32_t min_x, max_x;
     int32_t min_y, max_y;
@@ -25,8 +11,58 @@ struct TargetArea {
     }
 };
 
+static int64_t triangle(int64_t v) { return v * (v + 1) / 2; }
+
+// smallest v >= 0 with triangle(v) >= t
+static int64_t triangle_at_least(int64_t t) {
+    int64_t v = std::max<int64_t>(0, std::ceil((std::sqrt(1.0 + 8.0 * t) - 1) / 2));
+    while (v > 0 && triangle(v - 1) >= t) v--;
+    while (triangle(v) < t) v++;
+    return v;
+}
+
+// largest v >= 0 with triangle(v) <= t
+static int64_t triangle_at_most(int64_t t) {
+    int64_t v = std::max<int64_t>(0, std::floor((std::sqrt(1.0 + 8.0 * t) - 1) / 2));
+    while (triangle(v + 1) <= t) v++;
+    while (v > 0 && triangle(v) > t) v--;
+    return v;
+}
+
+/* After n steps with y velocity v, y = n * v - n * (n - 1) / 2. For a target
+ * below the origin, y only passes through it while falling, so the steps
+ * within [min_y, max_y] are the interval between the larger roots of
+ * n^2 - (2v + 1) n + 2 y = 0 for y = max_y and y = min_y.
+ */
+static std::pair<int64_t, int64_t> steps_in_target(int64_t v, int64_t min_y, int64_t max_y) {
+    auto y = [v](int64_t n) { return n * v - n * (n - 1) / 2; };
+    const double c = 2.0 * v + 1;
+
+    int64_t first = std::max<int64_t>(1, std::ceil((c + std::sqrt(c * c - 8.0 * max_y)) / 2));
+    while (first > 1 && y(first - 1) <= max_y) first--;
+    while (y(first) > max_y) first++;
+
+    int64_t last = std::floor((c + std::sqrt(c * c - 8.0 * min_y)) / 2);
+    while (y(last + 1) >= min_y) last++;
+    while (last >= first && y(last) < min_y) last--;
+
+    return {first, last};
+}
+
+/* After n steps with x velocity v > 0, x = triangle(v) if v <= n (it stopped),
+ * and n * v - n * (n - 1) / 2 otherwise. Both increase with v, so the x
+ * velocities ending in [min_x, max_x] after n steps are an interval, empty if
+ * lo > hi.
+ */
+static std::pair<int64_t, int64_t> x_velocities(int64_t n, int64_t min_x, int64_t max_x) {
+    const int64_t drag = n * (n - 1) / 2;
+    const int64_t lo = triangle(n) >= min_x ? triangle_at_least(min_x) : (min_x + drag + n - 1) / n;
+    const int64_t hi = triangle(n) <= max_x ? (max_x + drag) / n : triangle_at_most(max_x);
+    return {lo, hi};
+}
+
 parse::output_t day17(input_t in) {
-    int32_t part1 = std::numeric_limits<int32_t>().min();
+    int64_t part1 = std::numeric_limits<int64_t>().min();
     uint64_t part2 = 0;
 
     TargetArea ta;
@@ -49,24 +85,29 @@ parse::output_t day17(input_t in) {
         DEBUG("target area: x={}..{}, y={}..{}", ta.min_x, ta.max_x, ta.min_y, ta.max_y);
     }
 
-    Probe p;
-    for (int32_t y_velocity = ta.min_y; y_velocity < std::abs(ta.min_y); y_velocity++) {
-        for (int32_t x_velocity = 1; x_velocity <= ta.max_x; x_velocity++) {
-            p.x = 0;
-            p.y = 0;
-            p.x_velocity = x_velocity;
-            p.y_velocity = y_velocity;
-            int32_t max_y = std::numeric_limits<int32_t>().min();
-            for (size_t step = 1; step < std::numeric_limits<size_t>().max(); step++) {
-                p.step();
-                if (p.x > ta.max_x || p.y < ta.min_y) break;
-                if (p.y > max_y) max_y = p.y;
-                if (ta.contains(p.x, p.y)) {
-                    if (max_y > part1) part1 = max_y;
-                    part2++;
-                    break;
-                }
-            }
+    assert(ta.min_x > 0 && ta.max_y < 0);  // to the right and below
+
+    // for every y velocity which does not overshoot, the x velocity intervals of every step count in the target
+    std::vector<std::pair<int64_t, int64_t>> intervals;
+    for (int64_t y_velocity = ta.min_y; y_velocity < -int64_t(ta.min_y); y_velocity++) {
+        auto [first, last] = steps_in_target(y_velocity, ta.min_y, ta.max_y);
+
+        intervals.clear();
+        for (int64_t n = first; n <= last; n++) {
+            auto [lo, hi] = x_velocities(n, ta.min_x, ta.max_x);
+            if (lo <= hi) intervals.emplace_back(lo, hi);
+        }
+        if (intervals.empty()) continue;
+
+        // the highest hit is the highest y velocity
+        part1 = y_velocity > 0 ? triangle(y_velocity) : y_velocity;
+
+        std::sort(intervals.begin(), intervals.end());
+        int64_t covered = std::numeric_limits<int64_t>::min();  // highest x velocity counted so far
+        for (auto [lo, hi] : intervals) {
+            if (hi <= covered) continue;
+            part2 += hi - std::max(lo, covered + 1) + 1;
+            covered = hi;
         }
     }
 
@@ -114,4 +155,40 @@ TEST_CASE("day17, part 1 & part 2") {
     CHECK_EQ("1566", output.answer[1]);
 }
 
+TEST_CASE("day17: closed form matches simulation") {
+    struct Case {
+        int32_t min_x, max_x, min_y, max_y;
+    };
+    for (auto c : {Case{20, 30, -10, -5}, Case{1, 1, -1, -1}, Case{5, 40, -30, -1}, Case{100, 101, -3, -2}, Case{7, 9, -60, -45}}) {
+        int64_t part1 = std::numeric_limits<int64_t>::min();
+        uint64_t part2 = 0;
+        for (int32_t vy = c.min_y; vy < -c.min_y; vy++) {
+            for (int32_t vx = 1; vx <= c.max_x; vx++) {
+                int64_t x = 0, y = 0, dx = vx, dy = vy, top = std::numeric_limits<int64_t>::min();
+                while (x <= c.max_x && y >= c.min_y) {
+                    x += dx, y += dy, dx -= dx > 0, dy--;
+                    top = std::max(top, y);
+                    if (x >= c.min_x && x <= c.max_x && y >= c.min_y && y <= c.max_y) {
+                        part1 = std::max(part1, top);
+                        part2++;
+                        break;
+                    }
+                }
+            }
+        }
+
+        auto text = fmt::format("target area: x={}..{}, y={}..{}\n", c.min_x, c.max_x, c.min_y, c.max_y);
+        input_t in = {&text[0], static_cast<ssize_t>(text.length())};
+        auto output = day17(in);
+        CHECK_EQ(std::to_string(part1), output.answer[0]);
+        CHECK_EQ(std::to_string(part2), output.answer[1]);
+    }
+
+    // far beyond what the simulation can do
+    std::string large = "target area: x=200000..300000, y=-400000..-100000\n";
+    input_t in = {&large[0], static_cast<ssize_t>(large.length())};
+    auto output = day17(in);
+    CHECK_EQ("79999800000", output.answer[0]);
+}
+
 #endif  // IS_TEST
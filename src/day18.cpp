@@ -1,223 +1,189 @@
 #include "day18.h"
 
+#include <atomic>
+#include <thread>
+
 using parse::input_t;
 
-struct Pair {
-    Pair* left;
-    Pair* right;
-    long value;
+/* A snailfish number as an implicit binary tree of depth 5: a regular number
+ * at depth d covers 2^(5 - d) of the 32 leaf slots and is stored in the first
+ * of them, the others are EMPTY. Numbers being reduced are nested at most 5
+ * deep, so every number fits, explode and split only touch a few slots, and
+ * adding moves every slot of both halves to slot / 2.
+ */
+struct Snailfish {
+    static constexpr int MAX_DEPTH = 5;
+    static constexpr int SLOTS = 1 << MAX_DEPTH;
+    static constexpr int8_t EMPTY = -1;
 
-    Pair() : left(nullptr), right(nullptr), value(0) {}
+    std::array<uint8_t, SLOTS> value;
+    std::array<int8_t, SLOTS> depth;
 
-    uint64_t magnitude() const {
-        if (left == nullptr) return value;
-        return 3 * left->magnitude() + 2 * right->magnitude();
-    }
+    // number of slots covered by a number at depth d
+    static constexpr int width(int d) { return 1 << (MAX_DEPTH - d); }
 
-    ~Pair() {
-        if (left != nullptr) delete left;
-        if (right != nullptr) delete right;
+    Snailfish() {
+        value.fill(0);
+        depth.fill(EMPTY);
     }
-};
-
-size_t parse_pair_rec(const char s[], size_t len, Pair* out) {
-    if (len == 0) return 0;
 
-    assert(*s == '[' || (*s >= '0' && *s <= '9'));
-    auto start = s;
-    char* endptr;
-    if (*s != '[') {
-        // just a number
-        out->value = strtol(s, &endptr, 10);
-        return endptr - s;
+    Snailfish(std::string_view s) : Snailfish() {
+        const char *p = s.data();
+        parse(p, 0, 0);
     }
-    // pair
-    out->left = new Pair;
-    out->right = new Pair;
-    s++, len--;  // skip [
-    size_t bytes_read = parse_pair_rec(s, len, out->left);
-    s += bytes_read, len -= bytes_read;
-    assert(*s == ',');
-    s++, len--;  // skip comma
-    bytes_read = parse_pair_rec(s, len, out->right);
-    s += bytes_read, len -= bytes_read;
-    s++, len--;
-
-    bytes_read = s - start;
-    return bytes_read;
-}
-
-void parse_pair(const std::string& s, Pair* out) {
-    parse_pair_rec(s.c_str(), s.length(), out);
-}
 
-std::ostream& operator<<(std::ostream& os, const Pair& p) {
-    if (p.left == nullptr) {
-        os << p.value;
-    } else {
-        os << "[" << *p.left << "," << *p.right << "]";
+    void parse(const char *&p, int slot, int d) {
+        if (*p == '[') {
+            assert(d < MAX_DEPTH);
+            p++;  // [
+            parse(p, slot, d + 1);
+            p++;  // ,
+            parse(p, slot + width(d + 1), d + 1);
+            p++;  // ]
+        } else {
+            value[slot] = 0;
+            while (*p >= '0' && *p <= '9') value[slot] = 10 * value[slot] + *p++ - '0';
+            depth[slot] = d;
+        }
     }
-    return os;
-}
-
-struct Snailfish {
-    std::string repr;
 
-    Snailfish() : repr() {}
-
-    Snailfish(std::string repr) : repr(repr) {}
-
-    Snailfish operator+(const Snailfish& other) {
-        std::stringstream builder;
-        builder << "[" << repr << "," << other.repr << "]";
-        auto result = Snailfish(builder.str()).reduce();
-        return result;
+    std::string to_string(int slot = 0, int d = 0) const {
+        if (depth[slot] == d) return std::to_string(value[slot]);
+        return "[" + to_string(slot, d + 1) + "," + to_string(slot + width(d + 1), d + 1) + "]";
     }
 
-    Snailfish reduce() const {
-        DEBUG(">> reducing {}", repr);
-        // explode
-        int depth = 0;
-        for (size_t idx = 0; idx < repr.size() - 1; idx++) {
-            assert(depth >= 0);
-            switch (repr[idx]) {
-                case '[':
-                    ++depth;
-                    if (depth > 4) {
-                        //  only explode if this is a pair
-                        bool is_pair;
-                        {
-                            size_t i = idx + 1;
-                            while (repr[i] >= '0' && repr[i] <= '9') i++;
-                            is_pair = repr[i] == ',';
-                        }
-                        if (is_pair) return explode(idx).reduce();
-                    }
-                    break;
-                case ']':
-                    --depth;
-                    break;
+    // Explodes the leftmost pair nested inside four pairs, if any.
+    bool explode() {
+        const uint32_t deepest = parse::eq_mask32(reinterpret_cast<const char *>(depth.data()), MAX_DEPTH);
+        if (!deepest) return false;
+        const int left = std::countr_zero(deepest), right = left + 1;
+
+        for (int s = left - 1; s >= 0; s--) {
+            if (depth[s] != EMPTY) {
+                value[s] += value[left];
+                break;
             }
         }
-        // split
-        for (size_t idx = 0; idx < repr.size() - 1; idx++) {
-            if (repr[idx] >= '1' && repr[idx] <= '9' && repr[idx + 1] >= '0' && repr[idx + 1] <= '9') {
-                return split(idx).reduce();
+        for (int s = right + 1; s < SLOTS; s++) {
+            if (depth[s] != EMPTY) {
+                value[s] += value[right];
+                break;
             }
         }
-        return *this;
+
+        value[left] = 0;
+        depth[left] = MAX_DEPTH - 1;
+        value[right] = 0;
+        depth[right] = EMPTY;
+        return true;
     }
 
-    Snailfish explode(size_t pos) const {
-        assert(pos > 0 && pos < repr.size() - 1);
-        assert(repr[pos] == '[');
-
-        char* endptr;
-        long left_value = std::strtol(repr.c_str() + pos + 1, &endptr, 10);
-        long right_value = std::strtol(endptr + 1, NULL, 10);
-        DEBUG(">> explode at pos {}: [{},{}]", pos, left_value, right_value);
-
-        std::stringstream builder;
-
-        size_t left_idx = pos;
-        while (left_idx > 0 && (repr[left_idx] < '0' || repr[left_idx] > '9')) left_idx--;
-        // numbers can have more than one digit!
-        while (left_idx > 0 && (repr[left_idx - 1] >= '0' && repr[left_idx - 1] <= '9')) left_idx--;
-        if (left_idx > 0) {
-            char* endptr;
-            long left_number = std::strtol(repr.c_str() + left_idx, &endptr, 10);
-            DEBUG("found left_number: {}, left_value: {}", left_number, left_value);
-            for (size_t i = 0; i < left_idx; i++) builder << repr[i];
-            long sum = (left_number + left_value);
-            builder << sum;
-            // skip past the number we just inserted
-            while (repr[left_idx] >= '0' && repr[left_idx] <= '9') left_idx++;
-            for (size_t i = left_idx; i < pos; i++) builder << repr[i];
-        } else {
-            for (size_t i = 0; i < pos; i++) builder << repr[i];
+    // Splits the leftmost regular number of 10 or more, if any.
+    bool split() {
+        for (int s = 0; s < SLOTS; s++) {
+            if (depth[s] == EMPTY || value[s] < 10) continue;
+            const int d = ++depth[s];
+            const int right = s + width(d);
+            value[right] = (value[s] + 1) / 2;
+            depth[right] = d;
+            value[s] /= 2;
+            return true;
         }
-        builder << '0';                  // replace exploded pair with 0
-        while (repr[pos] != ']') pos++;  // skip exploded pair
-        pos++;
-
-        size_t right_idx = pos;
-        while (right_idx < repr.size() && (repr[right_idx] < '0' || repr[right_idx] > '9')) right_idx++;
-        if (right_idx < repr.size()) {
-            char* endptr;
-            long right_number = std::strtol(repr.c_str() + right_idx, &endptr, 10);
-            DEBUG("found right_number: {}", right_number);
-            for (size_t i = pos; i < right_idx; i++) builder << repr[i];
-            builder << (right_number + right_value);
-
-            const char* end = repr.c_str() + repr.size();
-            for (char* s = endptr; s != end; s++) builder << *s;
+        return false;
+    }
 
-        } else {
-            for (size_t i = pos; i < repr.size(); i++) builder << repr[i];
+    void reduce() {
+        while (explode() || split()) {
         }
-
-        return Snailfish(builder.str());
     }
 
-    Snailfish split(size_t pos) const {
-        assert(pos > 0 && pos < repr.size());
-        assert(repr[pos] >= '0' && repr[pos] <= '9');
-        assert(repr[pos + 1] >= '0' && repr[pos + 1] <= '9');
-        char* endptr;
-        long number = std::strtol(repr.c_str() + pos, &endptr, 10);
-        long left = number / 2;
-        long right = (number + 1) / 2;
-        DEBUG(">> split at pos {}: {} -> [{},{}]", pos, number, left, right);
-        std::stringstream builder;
-        for (size_t i = 0; i < pos; i++) builder << repr[i];
-        builder << "[" << left << "," << right << "]";
-
-        const char* end = repr.c_str() + repr.size();
-        for (char* s = endptr; s != end; s++) builder << *s;
-
-        return Snailfish(builder.str());
+    friend Snailfish operator+(const Snailfish &a, const Snailfish &b) {
+        Snailfish sum;
+        for (int s = 0; s < SLOTS; s += 2) {
+            // reduced numbers have no pairs nested inside four, so odd slots are empty
+            assert(a.depth[s + 1] == EMPTY && b.depth[s + 1] == EMPTY);
+            if (a.depth[s] != EMPTY) sum.value[s / 2] = a.value[s], sum.depth[s / 2] = a.depth[s] + 1;
+            if (b.depth[s] != EMPTY) sum.value[SLOTS / 2 + s / 2] = b.value[s], sum.depth[SLOTS / 2 + s / 2] = b.depth[s] + 1;
+        }
+        sum.reduce();
+        return sum;
     }
 
+    // pairs are combined bottom up, each into its left slot
     uint64_t magnitude() const {
-        Pair p;
-        parse_pair(repr, &p);
-        return p.magnitude();
+        std::array<uint64_t, SLOTS> m;
+        std::array<int8_t, SLOTS> d = depth;
+        for (int s = 0; s < SLOTS; s++) m[s] = value[s];
+        for (int level = MAX_DEPTH; level > 0; level--) {
+            for (int s = 0; s < SLOTS; s += 2 * width(level)) {
+                const int right = s + width(level);
+                if (d[s] != level) continue;
+                assert(d[right] == level);
+                m[s] = 3 * m[s] + 2 * m[right];
+                d[s] = level - 1;
+                d[right] = EMPTY;
+            }
+        }
+        return m[0];
     }
 };
 
-parse::output_t day18(input_t in) {
-    uint64_t part1, part2 = 0;
-
-    Snailfish fishes[100];
-    size_t n = 0;
-
-    auto parse_snailfish = [&]() -> Snailfish {
-        std::stringstream builder;
-        while (in.len > 0 && *in.s != '\n') {
-            builder << *in.s;
-            in.s++, in.len--;
+/* Largest magnitude of the sum of two different numbers. The rows of the
+ * n x n pair space are handed out in small batches through an atomic counter,
+ * every thread keeps its own maximum, and the maxima are combined at the end.
+ */
+static uint64_t largest_sum(std::span<const Snailfish> fishes, unsigned threads) {
+    const size_t n = fishes.size();
+    constexpr size_t ROWS_PER_BATCH = 4;
+
+    std::atomic<size_t> next_row = 0;
+    std::vector<uint64_t> best(threads, 0);
+
+    auto work = [&](unsigned t) {
+        uint64_t local = 0;
+        for (size_t first; (first = next_row.fetch_add(ROWS_PER_BATCH, std::memory_order_relaxed)) < n;) {
+            for (size_t i = first; i < std::min(n, first + ROWS_PER_BATCH); i++) {
+                for (size_t j = 0; j < n; j++) {
+                    if (i != j) local = std::max(local, (fishes[i] + fishes[j]).magnitude());
+                }
+            }
         }
-        in.s++, in.len--;
-        Snailfish fish(builder.str());
-        return fish;
+        best[t] = local;
     };
 
-    Snailfish result = parse_snailfish();
-    fishes[n++] = result;
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; t++) workers.emplace_back(work, t);
+    work(0);
+    for (auto &w : workers) w.join();
+
+    return *std::max_element(best.begin(), best.end());
+}
+
+static std::vector<Snailfish> parse_fishes(input_t in) {
+    std::vector<Snailfish> fishes;
     while (in.len > 0) {
-        Snailfish other = parse_snailfish();
-        fishes[n++] = other;
-        result = result + other;
+        const char *p = in.s;
+        fishes.emplace_back();
+        fishes.back().parse(p, 0, 0);
+        in.len -= p - in.s;
+        in.s = const_cast<char *>(p);
+        while (in.len > 0 && *in.s == '\n') in.s++, in.len--;
     }
+    return fishes;
+}
+
+parse::output_t day18(input_t in) {
+    uint64_t part1, part2 = 0;
+
+    const std::vector<Snailfish> fishes = parse_fishes(in);
+
+    Snailfish result = fishes[0];
+    for (size_t i = 1; i < fishes.size(); i++) result = result + fishes[i];
     part1 = result.magnitude();
 
-    for (size_t i = 0; i < n; i++) {
-        for (size_t j = 0; j < n; j++) {
-            if (i == j) continue;
-            uint64_t mag = (fishes[i] + fishes[j]).magnitude();
-            if (mag > part2) part2 = mag;
-        }
-    }
+    // threads only pay off for more than about a thousand sums
+    const unsigned threads = fishes.size() < 32 ? 1 : available_threads();
+    part2 = largest_sum(fishes, threads);
 
     return {part1, part2};
 }
@@ -238,50 +204,56 @@ int main() {
 using std::make_tuple;
 
 TEST_CASE("day18: explode no left neighbor, but right neighbor") {
-    const Snailfish fish(std::string("[[[[[9,8],1],2],3],4]"));
-    auto result = fish.explode(4);
+    Snailfish fish(std::string("[[[[[9,8],1],2],3],4]"));
+    auto result = fish;
+    CHECK(result.explode());
 
-    CHECK_EQ(std::string("[[[[0,9],2],3],4]"), result.repr);
+    CHECK_EQ(std::string("[[[[0,9],2],3],4]"), result.to_string());
 }
 
 TEST_CASE("day18: explode left neighbor, but no right neighbor") {
-    const Snailfish fish(std::string("[7,[6,[5,[4,[3,2]]]]]"));
-    auto result = fish.explode(12);
+    Snailfish fish(std::string("[7,[6,[5,[4,[3,2]]]]]"));
+    auto result = fish;
+    CHECK(result.explode());
 
-    CHECK_EQ(std::string("[7,[6,[5,[7,0]]]]"), result.repr);
+    CHECK_EQ(std::string("[7,[6,[5,[7,0]]]]"), result.to_string());
 }
 
 TEST_CASE("day18: explode III") {
-    const Snailfish fish(std::string("[[6,[5,[4,[3,2]]]],1]"));
-    auto result = fish.explode(10);
+    Snailfish fish(std::string("[[6,[5,[4,[3,2]]]],1]"));
+    auto result = fish;
+    CHECK(result.explode());
 
-    CHECK_EQ(std::string("[[6,[5,[7,0]]],3]"), result.repr);
+    CHECK_EQ(std::string("[[6,[5,[7,0]]],3]"), result.to_string());
 }
 
 TEST_CASE("day18: explode both sides") {
-    const Snailfish fish(std::string("[[3,[2,[1,[7,3]]]],[6,[5,[4,[3,2]]]]]"));
-    auto result = fish.explode(10);
+    Snailfish fish(std::string("[[3,[2,[1,[7,3]]]],[6,[5,[4,[3,2]]]]]"));
+    auto result = fish;
+    CHECK(result.explode());
 
-    CHECK_EQ(std::string("[[3,[2,[8,0]]],[9,[5,[4,[3,2]]]]]"), result.repr);
+    CHECK_EQ(std::string("[[3,[2,[8,0]]],[9,[5,[4,[3,2]]]]]"), result.to_string());
 }
 
 TEST_CASE("day18: explode last case") {
-    const Snailfish fish(std::string("[[3,[2,[8,0]]],[9,[5,[4,[3,2]]]]]"));
-    auto result = fish.explode(24);
-    CHECK_EQ(std::string("[[3,[2,[8,0]]],[9,[5,[7,0]]]]"), result.repr);
+    Snailfish fish(std::string("[[3,[2,[8,0]]],[9,[5,[4,[3,2]]]]]"));
+    auto result = fish;
+    CHECK(result.explode());
+    CHECK_EQ(std::string("[[3,[2,[8,0]]],[9,[5,[7,0]]]]"), result.to_string());
 }
 
 TEST_CASE("day18: split") {
-    const Snailfish fish(std::string("[[[[0,7],4],[15,[0,13]]],[1,1]]"));
-    auto result = fish.split(13);
-    CHECK_EQ(std::string("[[[[0,7],4],[[7,8],[0,13]]],[1,1]]"), result.repr);
+    Snailfish fish(std::string("[[[[0,7],4],[15,[0,13]]],[1,1]]"));
+    auto result = fish;
+    CHECK(result.split());
+    CHECK_EQ(std::string("[[[[0,7],4],[[7,8],[0,13]]],[1,1]]"), result.to_string());
 }
 
 TEST_CASE("day18: add simple") {
     Snailfish lhs(std::string("[[[[4,3],4],4],[7,[[8,4],9]]]"));
     Snailfish rhs(std::string("[1,1]"));
     auto result = lhs + rhs;
-    CHECK_EQ(std::string("[[[[0,7],4],[[7,8],[6,0]]],[8,1]]"), result.repr);
+    CHECK_EQ(std::string("[[[[0,7],4],[[7,8],[6,0]]],[8,1]]"), result.to_string());
 }
 
 TEST_CASE("day18: add small I") {
@@ -296,7 +268,7 @@ TEST_CASE("day18: add small I") {
         Snailfish rhs(s);
         result = result + rhs;
     }
-    CHECK_EQ(std::string("[[[[1,1],[2,2]],[3,3]],[4,4]]"), result.repr);
+    CHECK_EQ(std::string("[[[[1,1],[2,2]],[3,3]],[4,4]]"), result.to_string());
 }
 
 TEST_CASE("day18: add small II") {
@@ -312,7 +284,7 @@ TEST_CASE("day18: add small II") {
         Snailfish rhs(s);
         result = result + rhs;
     }
-    CHECK_EQ(std::string("[[[[3,0],[5,3]],[4,4]],[5,5]]"), result.repr);
+    CHECK_EQ(std::string("[[[[3,0],[5,3]],[4,4]],[5,5]]"), result.to_string());
 }
 
 TEST_CASE("day18: add small III") {
@@ -329,14 +301,14 @@ TEST_CASE("day18: add small III") {
         Snailfish rhs(s);
         result = result + rhs;
     }
-    CHECK_EQ(std::string("[[[[5,0],[7,4]],[5,5]],[6,6]]"), result.repr);
+    CHECK_EQ(std::string("[[[[5,0],[7,4]],[5,5]],[6,6]]"), result.to_string());
 }
 
 TEST_CASE("day18: add bug") {
     Snailfish lhs(std::string("[[[[6,6],[6,6]],[[6,0],[6,7]]],[[[7,7],[8,9]],[8,[8,1]]]]"));
     Snailfish rhs(std::string("[2,9]"));
     auto result = lhs + rhs;
-    CHECK_EQ(std::string("[[[[6,6],[7,7]],[[0,7],[7,7]]],[[[5,5],[5,6]],9]]"), result.repr);
+    CHECK_EQ(std::string("[[[[6,6],[7,7]],[[0,7],[7,7]]],[[[5,5],[5,6]],9]]"), result.to_string());
 }
 
 TEST_CASE("day18: add slightly larger") {
@@ -357,7 +329,7 @@ TEST_CASE("day18: add slightly larger") {
         Snailfish rhs(s);
         result = result + rhs;
     }
-    CHECK_EQ(std::string("[[[[8,7],[7,7]],[[8,6],[7,7]]],[[[0,7],[6,6]],[8,7]]]"), result.repr);
+    CHECK_EQ(std::string("[[[[8,7],[7,7]],[[8,6],[7,7]]],[[[0,7],[6,6]],[8,7]]]"), result.to_string());
 }
 
 TEST_CASE("day18: magnitude") {
@@ -381,8 +353,9 @@ TEST_CASE("day18: magnitude") {
 
 TEST_CASE("day18: explode bug") {
     Snailfish fish(std::string("[[[[0,7],4],[7,[[8,4],9]]],[1,1]]"));
-    auto result = fish.explode(16);
-    CHECK_EQ(std::string("[[[[0,7],4],[15,[0,13]]],[1,1]]"), result.repr);
+    auto result = fish;
+    CHECK(result.explode());
+    CHECK_EQ(std::string("[[[[0,7],4],[15,[0,13]]],[1,1]]"), result.to_string());
 }
 
 TEST_CASE("day18: examples") {
@@ -413,12 +386,23 @@ TEST_CASE("day18: examples") {
     }
 }
 
-TEST_CASE("day18 parse Pair") {
-    std::string s("[1,2]");
-    Pair pair;
-    parse_pair(s, &pair);
-    CHECK_EQ(1, pair.left->value);
-    CHECK_EQ(2, pair.right->value);
+TEST_CASE("day18 parse Snailfish") {
+    Snailfish fish(std::string("[1,2]"));
+    CHECK_EQ(1, fish.value[0]);
+    CHECK_EQ(1, fish.depth[0]);
+    CHECK_EQ(2, fish.value[Snailfish::SLOTS / 2]);
+    CHECK_EQ(1, fish.depth[Snailfish::SLOTS / 2]);
+    CHECK_EQ(std::string("[1,2]"), fish.to_string());
+}
+
+TEST_CASE("day18: parallel part 2") {
+    // 200 reduced numbers: the puzzle's and sums of them
+    std::vector<Snailfish> fishes = parse_fishes(parse::load_input("input/day18.txt"));
+    for (size_t i = 0; fishes.size() < 200; i++) fishes.push_back(fishes[i] + fishes[(7 * i + 3) % fishes.size()]);
+
+    const auto sequential = largest_sum(fishes, 1);
+    CHECK_EQ(sequential, largest_sum(fishes, 4));
+    CHECK_EQ(sequential, largest_sum(fishes, 7));
 }
 
 TEST_CASE("day18, part 1 & part 2") {
@@ -5,39 +5,41 @@
 
 #include "day19.h"
 
-#define MAX_SCANNERS 32
-#define MAX_POINTS 32
+#include <optional>
+#include <graph.h>
+
 #define OVERLAP_BOUND 12
 // // The threshold for number of overlapping probes was 12, this constitutes to binomial(n,2) = n*(n-1)/2 edges.
 #define EDGE_THRESHOLD 66
 using my_int = int32_t;
 
-enum Rotation {
-    IDENTITY,
-    ROTZ,
-    ROTX,
-    SPECIAL_ONE,
-    SPECIAL_TWO,
+// A proper rotation: a signed permutation matrix with determinant 1.
+struct rotation_t {
+    int8_t m[3][3];
 };
 
 #define ROTATION_COUNT 24
-// clang-format off
-// https://www.euclideanspace.com/maths/algebra/matrix/transforms/examples/index.htm
-constexpr Rotation ALL_ROTATIONS[ROTATION_COUNT] = {
-    IDENTITY,
-    ROTZ, ROTZ, ROTZ,
-    ROTX,
-    ROTZ, ROTZ, ROTZ,
-    ROTX,
-    ROTZ, ROTZ, ROTZ,
-    SPECIAL_ONE,
-    ROTZ, ROTZ, ROTZ,
-    ROTX,
-    ROTZ, ROTZ, ROTZ,
-    SPECIAL_TWO,
-    ROTZ, ROTZ, ROTZ,
-};
-// clang-format on
+
+// Every row has a single +-1, in the column picked by a permutation of the axes.
+// Odd permutations need an odd number of minus signs to keep the determinant at 1.
+static constexpr std::array<rotation_t, ROTATION_COUNT> make_rotations() {
+    constexpr int permutations[6][3] = {{0, 1, 2}, {1, 2, 0}, {2, 0, 1}, {0, 2, 1}, {2, 1, 0}, {1, 0, 2}};
+    std::array<rotation_t, ROTATION_COUNT> result{};
+    size_t n = 0;
+    for (int p = 0; p < 6; p++) {
+        const int parity = p < 3 ? 1 : -1;
+        for (int signs = 0; signs < 8; signs++) {
+            int sign[3] = {signs & 1 ? -1 : 1, signs & 2 ? -1 : 1, signs & 4 ? -1 : 1};
+            if (parity * sign[0] * sign[1] * sign[2] != 1) continue;
+            for (int row = 0; row < 3; row++) result[n].m[row][permutations[p][row]] = static_cast<int8_t>(sign[row]);
+            n++;
+        }
+    }
+    return result;
+}
+
+constexpr std::array<rotation_t, ROTATION_COUNT> ROTATIONS = make_rotations();
+static_assert(ROTATIONS[0].m[0][0] == 1 && ROTATIONS[0].m[1][1] == 1 && ROTATIONS[0].m[2][2] == 1);
 
 struct Point3D {
     my_int x, y, z;
@@ -56,11 +58,8 @@ struct Point3D {
         return {.x = x + other.x, .y = y + other.y, .z = z + other.z};
     }
 
-    inline int64_t dist(const Point3D& other) const {
-        auto dx = (other.x - x);
-        auto dy = other.y - y;
-        auto dz = other.z - z;
-        return dx * dx + dy * dy + dz * dz;
+    Point3D operator-() const {
+        return {.x = -x, .y = -y, .z = -z};
     }
 
     inline int64_t manhattan_dist(const Point3D& other) const {
@@ -71,28 +70,21 @@ struct Point3D {
         return x == other.x && y == other.y && z == other.z;
     }
 
-    Point3D rotx() {
-        return {.x = x, .y = -z, .z = y};
+    Point3D rotate(const rotation_t& r) const {
+        return {.x = r.m[0][0] * x + r.m[0][1] * y + r.m[0][2] * z,
+                .y = r.m[1][0] * x + r.m[1][1] * y + r.m[1][2] * z,
+                .z = r.m[2][0] * x + r.m[2][1] * y + r.m[2][2] * z};
     }
 
-    Point3D rotz() {
-        return {.x = -y, .y = x, .z = z};
-    }
-
-    Point3D special1() {
-        /* heading = 180 degrees
-         * attitude = 0
-         * bank = 90 degrees
-         *
-         * -1  0  0
-         *  0  0 -1
-         *  0 -1  0
-         */
-        return {.x = -x, .y = -z, .z = -y};
-    }
-
-    Point3D special2() {
-        return {.x = x, .y = z, .z = -y};
+    // The sorted absolute coordinates, packed 21 bits each. Rotations only permute
+    // and negate coordinates, so this is the same in every orientation.
+    uint64_t fingerprint() const {
+        uint64_t a = std::abs(x), b = std::abs(y), c = std::abs(z);
+        assert(a < (1 << 21) && b < (1 << 21) && c < (1 << 21));
+        if (a > b) std::swap(a, b);
+        if (b > c) std::swap(b, c);
+        if (a > b) std::swap(a, b);
+        return a << 42 | b << 21 | c;
     }
 };
 
@@ -112,71 +104,93 @@ MAKE_HASHABLE(Point3D, t.x, t.y, t.z)
 
 struct Scanner {
     std::optional<Point3D> m_location;
-    Point3D m_points[MAX_POINTS];
-    size_t m_count = 0;
-    std::vector<int64_t> m_distances;
-    std::unordered_map<int64_t, std::pair<size_t, size_t>> m_distance_to_points;
-    uint8_t m_rot_idx = 0;
-
-    void add_point(my_int x, my_int y, my_int z) {
-        assert(m_count < MAX_POINTS);
-        m_points[m_count++] = {.x = x, .y = y, .z = z};
+    std::vector<Point3D> m_points;  // relative to m_location once it is known, rotated to scanner 0
+};
+
+// The vector between two beacons of one scanner, keyed by its fingerprint.
+struct Fingerprint {
+    uint64_t key;
+    uint32_t scanner;
+    uint16_t first, second;  // indices into m_points
+};
+
+// Two beacon pairs of different scanners with the same fingerprint, `first` < `second`.
+struct Match {
+    uint32_t first, second;
+    uint16_t first_beacons[2], second_beacons[2];
+
+    bool operator<(const Match& other) const {
+        return std::tie(first, second) < std::tie(other.first, other.second);
     }
+};
 
-    void compute_distances() {
-        m_distances.reserve(m_count * m_count);
-        m_distance_to_points.reserve(m_count * m_count);
-        for (size_t i = 0; i < m_count; i++) {
-            for (size_t j = i + 1; j < m_count; j++) {
-                int64_t dist = m_points[i].dist(m_points[j]);
-                m_distances.push_back(dist);
-                m_distance_to_points[dist] = std::make_pair(i, j);
+/*
+ * Builds the index of all beacon pair fingerprints and returns every pair of pairs
+ * whose fingerprints collide, grouped by scanner pair. Scanners that share at least
+ * OVERLAP_BOUND beacons share at least EDGE_THRESHOLD fingerprints.
+ */
+static std::vector<Match> matching_pairs(const std::vector<Scanner>& scanners) {
+    std::vector<Fingerprint> index;
+    for (uint32_t s = 0; s < scanners.size(); s++) {
+        const auto& points = scanners[s].m_points;
+        assert(points.size() <= std::numeric_limits<uint16_t>::max());
+        for (uint16_t i = 0; i < points.size(); i++) {
+            for (uint16_t j = i + 1; j < points.size(); j++) {
+                index.push_back({(points[j] - points[i]).fingerprint(), s, i, j});
             }
         }
-        std::sort(m_distances.begin(), m_distances.end());
     }
-
-    void rotate() {
-        m_rot_idx++;
-        assert(m_rot_idx < ROTATION_COUNT);
-        switch (ALL_ROTATIONS[m_rot_idx]) {
-            case IDENTITY:
-                break;
-            case ROTZ:
-                for (size_t i = 0; i < m_count; i++) m_points[i] = m_points[i].rotz();
-                break;
-            case ROTX:
-                for (size_t i = 0; i < m_count; i++) m_points[i] = m_points[i].rotx();
-                break;
-            case SPECIAL_ONE:
-                for (size_t i = 0; i < m_count; i++) m_points[i] = m_points[i].special1();
-                break;
-            case SPECIAL_TWO:
-                for (size_t i = 0; i < m_count; i++) m_points[i] = m_points[i].special2();
-                break;
+    std::sort(index.begin(), index.end(), [](auto& a, auto& b) { return a.key < b.key; });
+
+    std::vector<Match> matches;
+    for (size_t begin = 0, end; begin < index.size(); begin = end) {
+        for (end = begin + 1; end < index.size() && index[end].key == index[begin].key; end++);
+        for (size_t i = begin; i < end; i++) {
+            for (size_t j = i + 1; j < end; j++) {
+                auto a = &index[i], b = &index[j];
+                if (a->scanner == b->scanner) continue;
+                if (a->scanner > b->scanner) std::swap(a, b);
+                matches.push_back({a->scanner, b->scanner, {a->first, a->second}, {b->first, b->second}});
+            }
         }
     }
-};
+    std::sort(matches.begin(), matches.end());
+    return matches;
+}
 
-struct OverlapResult {
-    size_t first, second;  // index into scanners array
-    int64_t common_distance;
-};
+/*
+ * Tries to place scanner `to` with the matched pair of beacons in the placed scanner `from`:
+ * every rotation that turns one difference vector into the other (or its opposite) gives a
+ * candidate location. A candidate is accepted when OVERLAP_BOUND beacons line up with ones
+ * already known.
+ */
+static bool align(Scanner& to, const Point3D from_beacons[2], const Point3D to_beacons[2],
+                  const std::unordered_set<Point3D>& beacons) {
+    const Point3D expected = from_beacons[1] - from_beacons[0];
+    const Point3D diff = to_beacons[1] - to_beacons[0];
+    for (auto& rotation : ROTATIONS) {
+        const Point3D rotated = diff.rotate(rotation);
+        Point3D location;
+        if (rotated == expected) {
+            location = from_beacons[0] - to_beacons[0].rotate(rotation);
+        } else if (rotated == -expected) {
+            location = from_beacons[0] - to_beacons[1].rotate(rotation);
+        } else {
+            continue;
+        }
 
-static std::optional<Point3D> scanner_location(const std::pair<Point3D, Point3D>& beacon_pair1,
-                                               const std::pair<Point3D, Point3D>& beacon_pair2) {
-    {
-        auto loc1 = beacon_pair1.first - beacon_pair2.first;
-        auto loc2 = beacon_pair1.second - beacon_pair2.second;
-        if (loc1 == loc2) return loc1;
-    }
-    {
-        auto loc1 = beacon_pair1.first - beacon_pair2.second;
-        auto loc2 = beacon_pair1.second - beacon_pair2.first;
-        if (loc1 == loc2) return loc1;
+        size_t overlap = 0;
+        for (size_t k = 0; k < to.m_points.size() && overlap < OVERLAP_BOUND; k++) {
+            overlap += beacons.count(to.m_points[k].rotate(rotation) + location);
+        }
+        if (overlap < OVERLAP_BOUND) continue;
+
+        DEBUG("Scanner has location {}", location);
+        for (auto& p : to.m_points) p = p.rotate(rotation) + location;
+        to.m_location = location;
+        return true;
     }
-    std::optional<Point3D> result;
-    return result;
+    return false;
 }
 
 using parse::input_t;
@@ -184,167 +198,88 @@ using parse::input_t;
 parse::output_t day19(input_t in) {
     long part1, part2;
 
-    size_t scanner_count;
-    Scanner scanners[MAX_SCANNERS];
-    scanners[0].m_location = {0, 0, 0};
-    {
-        int scanner_idx = -1;
-        while (in.len > 4) {
-            if (*(in.s + 4) == 's') {  // start new scanner
-                scanner_idx++;
-                parse::seek_next_line(in);
-                continue;
-            }
-
-            auto x = static_cast<my_int>(parse::number(in));
-            in.s++, in.len--;  // skip comma
-            auto y = static_cast<my_int>(parse::number(in));
-            in.s++, in.len--;  // skip comma
-            auto z = static_cast<my_int>(parse::number(in));
-            scanners[scanner_idx].add_point(x, y, z);
-
+    std::vector<Scanner> scanners;
+    while (in.len > 4) {
+        if (*(in.s + 4) == 's') {  // start new scanner
+            scanners.emplace_back();
             parse::seek_next_line(in);
-            while (in.len && *in.s == '\n') { in.s++, in.len--; };
+            continue;
         }
-        scanner_count = scanner_idx + 1;
-    }
-    DEBUG("Parsed {} scanners", scanner_count);
 
-    /*
-     * Step 1: For each scanner, compute the distance between any two beacons.
-     */
-    for (size_t alpha = 0; alpha < scanner_count; alpha++) {
-        scanners[alpha].compute_distances();
+        auto x = static_cast<my_int>(parse::number(in));
+        in.s++, in.len--;  // skip comma
+        auto y = static_cast<my_int>(parse::number(in));
+        in.s++, in.len--;  // skip comma
+        auto z = static_cast<my_int>(parse::number(in));
+        scanners.back().m_points.push_back({.x = x, .y = y, .z = z});
+
+        parse::seek_next_line(in);
+        while (in.len && *in.s == '\n') { in.s++, in.len--; };
     }
+    DEBUG("Parsed {} scanners", scanners.size());
 
     /*
-     * Step 2: Find overlapping scanners.
-     * This function does not guarantee that two scanners overlap, but there is strong evidence
-     * that two scanners might overlap. If a scanner is not in the result then it does definitely not
-     * overlap with `s1`.
+     * Step 1: Index the fingerprints of all beacon pairs and find the scanner pairs that
+     * share enough of them. This does not guarantee that two scanners overlap, but
+     * scanners that are not found here definitely do not.
      */
-    std::vector<OverlapResult> overlapping_scanners;
-    overlapping_scanners.reserve(MAX_SCANNERS * (MAX_SCANNERS - 1));
-    for (size_t alpha = 0; alpha < scanner_count; alpha++) {
-        auto n = scanners[alpha].m_distances.size();
-        for (size_t beta = alpha + 1; beta < scanner_count; beta++) {
-            auto m = scanners[beta].m_distances.size();
-            uint64_t common_count = 0;
-            size_t i = 0, j = 0;
-            std::vector<int64_t> common_distances;
-            common_distances.reserve(MAX_POINTS * MAX_POINTS);
-            while (i < n && j < m) {
-                if (scanners[alpha].m_distances[i] == scanners[beta].m_distances[j]) {
-                    common_count++;
-                    common_distances.push_back(scanners[alpha].m_distances[i]);
-                    i++;
-                    j++;
-                } else if (scanners[alpha].m_distances[i] > scanners[beta].m_distances[j]) {
-                    j++;
-                } else {
-                    i++;
-                }
-            }
-            if (common_count >= EDGE_THRESHOLD) {
-                OverlapResult result = {.first = alpha, .second = beta, .common_distance = common_distances[0]};
-                overlapping_scanners.push_back(result);
-            }
+    const std::vector<Match> matches = matching_pairs(scanners);
+
+    graph::builder_t<uint32_t> overlaps;  // weight: the first match of the scanner pair
+    overlaps.reserve_vertices(scanners.size());
+    for (size_t begin = 0, end; begin < matches.size(); begin = end) {
+        for (end = begin + 1; end < matches.size() && !(matches[begin] < matches[end]); end++);
+        if (end - begin >= EDGE_THRESHOLD) {
+            overlaps.add_edge(matches[begin].first, matches[begin].second, begin, false);
         }
     }
+    const auto graph = overlaps.build();
 
-    /* Step 3: For each of these overlapping scanners (s1 and s2, say), use a pair of beacons to find the correct rotation of
-     * beacons in s2 so that they align to beacons in s1. As part of finding the rotation, the location of the scanner
-     * (relative to the first scanner) pops out.
+    /*
+     * Step 2: Starting from scanner 0, place the scanners overlapping with a placed one.
+     * Their beacons are rotated and moved to the coordinates of scanner 0 on the way,
+     * so every placed scanner can be used directly to align the next one.
      */
     std::unordered_set<Point3D> unique_beacons;
-    unique_beacons.reserve(MAX_SCANNERS * MAX_POINTS);
-    for (size_t i = 0; i < scanners[0].m_count; i++) unique_beacons.insert(scanners[0].m_points[i]);
-    size_t processed = 1;
-    while (processed < scanner_count) {
-        for (const auto& overlap_result : overlapping_scanners) {
-            size_t i = overlap_result.first;
-            size_t j = overlap_result.second;
-            if (scanners[i].m_location.has_value() && scanners[j].m_location.has_value()) continue;
-            if (!scanners[i].m_location.has_value() && !scanners[j].m_location.has_value()) continue;
-            if (!scanners[i].m_location.has_value()) {
-                auto old = i;
-                i = j;
-                j = old;
-            }
+    scanners[0].m_location = {0, 0, 0};
+    unique_beacons.insert(scanners[0].m_points.begin(), scanners[0].m_points.end());
+
+    std::vector<uint32_t> queue = {0};
+    for (size_t head = 0; head < queue.size(); head++) {
+        const uint32_t i = queue[head];
+        auto neighbours = graph.edges(i);
+        auto first_match = graph.weights(i);
+        for (size_t e = 0; e < neighbours.size(); e++) {
+            const uint32_t j = neighbours[e];
+            if (scanners[j].m_location.has_value()) continue;
             DEBUG("Using scanner {} at location {} to align scanner {}", i, *scanners[i].m_location, j);
-            DEBUG("Common distances: {}", overlap_result.common_distances);
-
-            // i is processed, j is not processed
-            assert(scanners[i].m_location.has_value());
-            assert(!scanners[j].m_location.has_value());
-            assert(scanners[j].m_rot_idx == 0);
-
-            auto s1_indices = scanners[i].m_distance_to_points[overlap_result.common_distance];
-            std::pair<Point3D, Point3D> s1_beacons = std::make_pair(
-                scanners[i].m_points[s1_indices.first],
-                scanners[i].m_points[s1_indices.second]);
-            DEBUG("s1_beacons: {}", s1_beacons);
-
-            auto s2_indices = scanners[j].m_distance_to_points[overlap_result.common_distance];
-            std ::pair<Point3D, Point3D> s2_beacons = std::make_pair(
-                scanners[j].m_points[s2_indices.first],
-                scanners[j].m_points[s2_indices.second]);
-            DEBUG("s2_beacons: {}", s2_beacons);
-
-            // find orientation of s2
-            for (uint8_t rot_idx = 0; rot_idx < ROTATION_COUNT; rot_idx++) {
-                switch (ALL_ROTATIONS[rot_idx]) {
-                    case IDENTITY:
-                        break;
-                    case ROTZ:
-                        s2_beacons.first = s2_beacons.first.rotz();
-                        s2_beacons.second = s2_beacons.second.rotz();
-                        break;
-                    case ROTX:
-                        s2_beacons.first = s2_beacons.first.rotx();
-                        s2_beacons.second = s2_beacons.second.rotx();
-                        break;
-                    case SPECIAL_ONE:
-                        s2_beacons.first = s2_beacons.first.special1();
-                        s2_beacons.second = s2_beacons.second.special1();
-                        break;
-                    case SPECIAL_TWO:
-                        s2_beacons.first = s2_beacons.first.special2();
-                        s2_beacons.second = s2_beacons.second.special2();
-                        break;
-                }
-                DEBUG("rotate2: {}", s2_beacons);
-                std::optional<Point3D> maybe_location = scanner_location(s1_beacons, s2_beacons);
-                if (maybe_location.has_value()) {
-                    Point3D location = maybe_location.value();
-                    DEBUG("Scanner {} has location {}", j, location);
-                    // We need to adjust the location so that it is relative to
-                    // the first scanner (ie scanners[1]), which is
-                    // what scanner[id1] has been aligned to.
-                    location += scanners[i].m_location.value();
-
-                    scanners[j].m_location = location;
-
-                    for (uint8_t rot_counter = 0; rot_counter < rot_idx; rot_counter++) {
-                        scanners[j].rotate();
-                    }
-
-                    for (size_t k = 0; k < scanners[j].m_count; k++) {
-                        unique_beacons.insert(scanners[j].m_points[k] + location);
-                    }
-
-                    processed++;
-                    break;
-                }
+
+            const Match& first = matches[first_match[e]];
+            for (size_t m = first_match[e]; m < matches.size() && !(first < matches[m]); m++) {
+                const bool swapped = matches[m].first != i;
+                auto i_beacons = swapped ? matches[m].second_beacons : matches[m].first_beacons;
+                auto j_beacons = swapped ? matches[m].first_beacons : matches[m].second_beacons;
+                const Point3D from[2] = {scanners[i].m_points[i_beacons[0]], scanners[i].m_points[i_beacons[1]]};
+                const Point3D to[2] = {scanners[j].m_points[j_beacons[0]], scanners[j].m_points[j_beacons[1]]};
+                if (align(scanners[j], from, to, unique_beacons)) break;
             }
-            DEBUG("processed: {}", processed);
+            if (!scanners[j].m_location.has_value()) continue;
+
+            unique_beacons.insert(scanners[j].m_points.begin(), scanners[j].m_points.end());
+            queue.push_back(j);
         }
     }
+    DEBUG("processed: {}", queue.size());
+    if (queue.size() != scanners.size()) {
+        fmt::print(stderr, "day19: {} of {} scanners cannot be placed relative to scanner 0\n",
+                   scanners.size() - queue.size(), scanners.size());
+        return {"-", "-"};
+    }
 
     part1 = unique_beacons.size();
-    part2 = std::numeric_limits<long>().min();
-    for (size_t i = 0; i < scanner_count; i++) {
-        for (size_t j = 0; j < scanner_count; j++) {
+    part2 = 0;
+    for (size_t i = 0; i < scanners.size(); i++) {
+        for (size_t j = i + 1; j < scanners.size(); j++) {
             auto dist = scanners[i].m_location->manhattan_dist(*scanners[j].m_location);
             if (dist > part2) part2 = dist;
         }
@@ -364,6 +299,7 @@ int main() {
 #ifdef IS_TEST
 
 #include <doctest/doctest.h>
+#include <random>
 
 using std::make_tuple;
 
@@ -525,4 +461,51 @@ TEST_CASE("day19, part 1 & part 2") {
     CHECK_EQ(11060, std::strtol(output.answer[1].c_str(), NULL, 10));
 }
 
+
+TEST_CASE("day19: scanner without overlap") {
+    std::string text = "--- scanner 0 ---\n";
+    for (int i = 0; i < 12; i++) text += fmt::format("{},{},{}\n", i, i * i, i * i * i);
+    text += "\n--- scanner 1 ---\n";
+    for (int i = 0; i < 12; i++) text += fmt::format("{},{},{}\n", i, 2 * i, 3 * i);
+
+    input_t in = {&text[0], static_cast<ssize_t>(text.length())};
+    auto output = day19(in);
+    CHECK_EQ("-", output.answer[0]);
+    CHECK_EQ("-", output.answer[1]);
+}
+
+TEST_CASE("day19: hundreds of scanners") {
+    // scanners on a 6x6x6 lattice, 600 apart so that neighbours share most of their cubes,
+    // each looking at the random beacons within 1000 in its own orientation
+    std::mt19937 rng(19);
+    const my_int spacing = 600, side = 6;
+    std::uniform_int_distribution<my_int> coordinate(-1000, spacing * (side - 1) + 1000);
+    const size_t volume = (2000 + spacing * (side - 1)) / 100;
+    std::unordered_set<Point3D> beacons;
+    while (beacons.size() < 30 * volume * volume * volume / 8000) {
+        beacons.insert({coordinate(rng), coordinate(rng), coordinate(rng)});
+    }
+
+    std::string text;
+    std::unordered_set<Point3D> seen;
+    for (my_int s = 0; s < side * side * side; s++) {
+        const Point3D location = {spacing * (s % side), spacing * (s / side % side), spacing * (s / side / side)};
+        const rotation_t& rotation = ROTATIONS[rng() % ROTATION_COUNT];
+        text += fmt::format("--- scanner {} ---\n", s);
+        for (auto& b : beacons) {
+            const Point3D d = b - location;
+            if (std::abs(d.x) > 1000 || std::abs(d.y) > 1000 || std::abs(d.z) > 1000) continue;
+            const Point3D p = d.rotate(rotation);
+            text += fmt::format("{},{},{}\n", p.x, p.y, p.z);
+            seen.insert(b);
+        }
+        text += '\n';
+    }
+
+    input_t in = {&text[0], static_cast<ssize_t>(text.length())};
+    auto output = day19(in);
+    CHECK_EQ(std::to_string(seen.size()), output.answer[0]);
+    CHECK_EQ(std::to_string(3 * spacing * (side - 1)), output.answer[1]);
+}
+
 #endif  // IS_TEST
@@ -0,0 +1,37 @@
+// Tests of share/cpp/graph.h.
+
+#include <doctest/doctest.h>
+#include <map>
+
+#include "graph.h"
+
+TEST_CASE("graph: csr builder") {
+    // enough edges for several threads, with plenty of parallel edges
+    const uint32_t n = 5000;
+    graph::builder_t<int> builder;
+    std::vector<std::map<uint32_t, int>> expected(n);
+    uint64_t x = 1;
+    for (int i = 0; i < 300000; i++) {
+        x = x * 6364136223846793005 + 1442695040888963407;
+        uint32_t from = (x >> 33) % n, to = (x >> 13) % n;
+        int weight = x % 100;
+        builder.add_edge(from, to, weight);
+        auto [it, inserted] = expected[from].emplace(to, weight);
+        if (!inserted) it->second = std::min(it->second, weight);
+    }
+    auto g = builder.build(true, 4);
+
+    CHECK_EQ(n, g.nvertices());
+    bool same = true;
+    for (uint32_t v = 0; v < n; v++) {
+        auto edges = g.edges(v);
+        auto weights = g.weights(v);
+        same &= edges.size() == expected[v].size();
+        size_t i = 0;
+        for (auto [to, weight] : expected[v]) {
+            same &= i < edges.size() && edges[i] == to && weights[i] == weight;
+            i++;
+        }
+    }
+    CHECK(same);
+}